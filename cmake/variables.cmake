@@ -9,6 +9,25 @@ if(PROJECT_IS_TOP_LEVEL)
   option(BUILD_SHARED_LIBS "Build shared libs." OFF)
 endif()
 
+# ---- Compile-time log level ----
+
+# HERT_LOG_* macros below this level expand to nothing, e.g. INFO for release
+# builds strips every TRACE/DEBUG call site. Empty keeps all levels.
+set(
+    HERT_LOG_ACTIVE_LEVEL ""
+    CACHE STRING
+    "Compile-time minimum log level (TRACE/DEBUG/INFO/WARN/ERROR/CRITICAL/OFF)"
+)
+set_property(
+    CACHE HERT_LOG_ACTIVE_LEVEL PROPERTY
+    STRINGS "" TRACE DEBUG INFO WARN ERROR CRITICAL OFF
+)
+
+# ---- Tools ----
+
+# hert-logcat decodes the binary log files written by the binary sink
+option(HERT_BUILD_TOOLS "Build the hert-logcat binary log decoder" ON)
+
 # ---- Suppress C4251 on Windows ----
 
 # Please see include/Hert/Hert.hpp for more details
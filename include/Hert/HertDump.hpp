@@ -10,6 +10,10 @@ class HertDump
 public:
   /**
    * @brief 初始化并安装信号/异常处理器，自动打印崩溃堆栈并转储 core 文件
+   *
+   * coreDir 非空时同时启用 HertLog 的飞行记录器，崩溃时各线程最近的日志
+   * （含被级别过滤的 TRACE/DEBUG）写入 coreDir/flight_<pid>.hlog，可用
+   * hert-logcat 查看。
    * @param coreDir core 文件保存目录（可选）
    */
   static void init(const std::string& coreDir = "");
@@ -26,6 +30,8 @@ public:
 
   /**
    * @brief 设置 core dump 文件保存目录
+   *
+   * 初始化后设置非空目录会启用飞行记录器，清空目录则停用它。
    */
   static void setCoreDumpDir(const std::string& dir);
 
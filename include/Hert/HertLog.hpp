@@ -1,11 +1,15 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include <fmt/format.h>
 #include <spdlog/async.h>
@@ -15,11 +19,36 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include "Hert/HertLogArgs.hpp"
+#include "Hert/HertLogLimit.hpp"
+
 #ifdef QT_CORE_LIB
 #  include <QDebug>
+#  include <QLoggingCategory>
 #  include <QtLogging>
 #endif
 
+/**
+ * @brief 编译期日志级别，与LogLevel的取值一一对应
+ */
+#define HERT_LOG_LEVEL_TRACE 0
+#define HERT_LOG_LEVEL_DEBUG 1
+#define HERT_LOG_LEVEL_INFO 2
+#define HERT_LOG_LEVEL_WARN 3
+#define HERT_LOG_LEVEL_ERROR 4
+#define HERT_LOG_LEVEL_CRITICAL 5
+#define HERT_LOG_LEVEL_OFF 6
+
+/**
+ * @brief 编译期保留的最低级别，低于该级别的HERT_LOG_*宏展开为空
+ *
+ * 例如Release构建中定义 HERT_LOG_ACTIVE_LEVEL=HERT_LOG_LEVEL_INFO
+ * 即可彻底移除TRACE/DEBUG调用。
+ */
+#ifndef HERT_LOG_ACTIVE_LEVEL
+#  define HERT_LOG_ACTIVE_LEVEL HERT_LOG_LEVEL_TRACE
+#endif
+
 namespace Hert
 {
 
@@ -37,6 +66,201 @@ enum class LogLevel : std::uint8_t
   OFF = 6
 };
 
+/**
+ * @brief 文件输出在flush时的落盘策略
+ */
+enum class LogSyncPolicy : std::uint8_t
+{
+  NONE = 0,  // 只写入内核，由内核回写
+  ASYNC = 1,  // 发起回写但不等待，msync(MS_ASYNC)或sync_file_range
+  SYNC = 2,  // 等待数据落盘，msync(MS_SYNC)或fdatasync
+};
+
+/**
+ * @brief 文件输出按时间轮转的周期，以本地时间的整点或零点为界
+ */
+enum class LogRotationPeriod : std::uint8_t
+{
+  NONE = 0,  // 只按大小轮转
+  HOURLY = 1,  // 每小时轮转
+  DAILY = 2,  // 每天零点轮转
+};
+
+/**
+ * @brief 异步队列已满时的处理方式
+ *
+ * ERROR及以上级别的记录走单独的队列，不受此策略影响，满时总是等待。
+ * 非BLOCK策略或设置了等待时限时使用每线程队列后端。
+ */
+enum class LogOverflowPolicy : std::uint8_t
+{
+  BLOCK = 0,  // 等待后台线程腾出空间，可由overflow_timeout_ms限时
+  DROP_NEWEST = 1,  // 丢弃当前记录
+  OVERWRITE_OLDEST = 2,  // 丢弃队列中最旧的记录
+};
+
+/**
+ * @brief 日志时间戳的时钟源
+ *
+ * TSC只用于每线程队列后端：调用线程读取rdtsc，后台线程按定期对照
+ * CLOCK_REALTIME校准的频率换算为系统时间，每个线程的时间戳单调不减。
+ * CPU不支持不变TSC时退回SYSTEM。
+ */
+enum class LogClockSource : std::uint8_t
+{
+  SYSTEM = 0,  // system_clock::now()
+  TSC = 1,  // 校准后的时间戳计数器(仅x86)
+};
+
+/**
+ * @brief 异步队列因溢出丢失的记录数，自初始化以来累计
+ */
+struct LogDropStats
+{
+  std::uint64_t dropped = 0;  // DROP_NEWEST丢弃的新记录
+  std::uint64_t overwritten = 0;  // OVERWRITE_OLDEST丢弃的旧记录
+  std::uint64_t timed_out = 0;  // BLOCK等待超时后丢弃的记录
+
+  std::uint64_t total() const { return dropped + overwritten + timed_out; }
+};
+
+/**
+ * @brief 日志调用点的静态信息，HERT_LOG_*宏在每个展开处生成一份
+ */
+struct LogSite
+{
+  LogLevel level;
+  const char* file;  // 源文件完整路径
+  const char* basename;  // 去掉目录的文件名
+  int line;
+};
+
+namespace detail
+{
+/**
+ * @brief 截取路径中的文件名部分，可在编译期求值
+ */
+constexpr const char* basename(const char* path)
+{
+  const char* result = path;
+  for (const char* p = path; *p != '\0'; ++p) {
+    if (*p == '/' || *p == '\\') {
+      result = p + 1;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief 级别是否高于编译期保留的最低级别
+ */
+constexpr bool level_active(LogLevel level)
+{
+  return static_cast<int>(level) - HERT_LOG_ACTIVE_LEVEL >= 0;
+}
+}  // namespace detail
+
+/**
+ * @brief 调用点的运行时开关
+ */
+enum class LogSiteState : std::uint8_t
+{
+  DEFAULT = 0,  // 按级别(或分类级别)判断
+  ENABLED = 1,  // 总是输出，不受级别限制
+  DISABLED = 2,  // 总是不输出
+};
+
+/**
+ * @brief 注册表中一个调用点的信息
+ */
+struct LogSiteInfo
+{
+  LogLevel level;
+  const char* file;
+  int line;
+  const char* format;
+  LogSiteState state;
+};
+
+namespace detail
+{
+/**
+ * @brief 登记一个调用点，按已设置的匹配规则初始化其状态
+ */
+void register_log_site(const LogSite& site,
+                       const char* format,
+                       std::atomic<LogSiteState>& state);
+
+/**
+ * @brief 每个宏展开处实例化一次的调用点条目
+ *
+ * 状态是常量初始化的静态变量，读取时没有局部静态变量的初始化检查；
+ * registered的动态初始化在main之前完成登记，在此之前状态保持DEFAULT。
+ */
+template<typename Tag>
+struct LogSiteEntry
+{
+  static constexpr LogSite site = Tag::site();
+  static inline constinit std::atomic<LogSiteState> s_state {
+      LogSiteState::DEFAULT};
+  static inline const bool registered =
+      (register_log_site(site, Tag::format_text(), s_state), true);
+
+  static LogSiteState state()
+  {
+    (void)registered;  // 引用以实例化登记
+    return s_state.load(std::memory_order_relaxed);
+  }
+};
+
+class LogCategoryRegistry;
+
+// fmt::runtime的返回类型；旧编译器上fmt不做编译期检查，它就是string_view，
+// 与字面量无法区分
+using RuntimeFormat = decltype(fmt::runtime(fmt::string_view {}));
+inline constexpr bool kRuntimeFormatDistinct =
+    !std::is_same_v<RuntimeFormat, fmt::string_view>;
+}  // namespace detail
+
+/**
+ * @brief 具名的日志分类，名称以"."分层，如"net.io"
+ *
+ * 名称在注册表中驻留到进程退出，name()返回的指针可随记录进入后端
+ * 队列与飞行记录器，分类对象先于记录销毁也不会悬空。每个分类
+ * 保存自身的生效级别：显式设置过的最近祖先(含自身)的级别，否则为
+ * 全局级别。级别变化时在注册表锁内重新计算所有分类，写日志时的判断
+ * 只是一次relaxed原子读取。
+ */
+class LogCategory
+{
+public:
+  explicit LogCategory(std::string_view name);
+  ~LogCategory();
+
+  LogCategory(const LogCategory&) = delete;
+  LogCategory& operator=(const LogCategory&) = delete;
+  LogCategory(LogCategory&&) = delete;
+  LogCategory& operator=(LogCategory&&) = delete;
+
+  const char* name() const { return m_name; }
+
+  /**
+   * @brief 当前生效的级别，日志系统未初始化时为OFF
+   */
+  LogLevel level() const { return m_level.load(std::memory_order_relaxed); }
+
+  bool is_enabled(LogLevel level) const
+  {
+    return level >= m_level.load(std::memory_order_relaxed);
+  }
+
+private:
+  friend class detail::LogCategoryRegistry;
+
+  const char* m_name;  // 驻留在注册表中
+  std::atomic<LogLevel> m_level {LogLevel::OFF};
+};
+
 /**
  * @brief 日志输出目标配置
  */
@@ -45,12 +269,68 @@ struct LogSinkConfig
   bool console_enabled = true;  // 是否启用控制台输出
   bool file_enabled = false;  // 是否启用文件输出
   std::string file_path = "hert.log";  // 文件路径
+  // 轮转出的文件按递增序号命名为hert.000001.log、hert.000002.log等，序号
+  // 越大越新；不再沿用spdlog的hert.1.log(1为最新)，按旧命名查找历史文件的
+  // 脚本需相应调整
   size_t max_file_size = 1024UL * 1024UL * 10UL;  // 最大文件大小(10MB)
   size_t max_files = 3;  // 最大文件数量
+  LogRotationPeriod rotation_period = LogRotationPeriod::NONE;  // 按时间轮转
   LogLevel console_level = LogLevel::INFO;  // 控制台日志级别
   LogLevel file_level = LogLevel::DEBUG;  // 文件日志级别
+  bool compress_rotated = false;  // 后台gzip压缩轮转出的文件，max_files计压缩包
+  size_t dedup_window_ms = 0;  // 折叠连续重复记录的窗口(毫秒)，0为不折叠
+  bool sink_workers = false;  // 控制台与文件各用独立的队列和写入线程
+  size_t sink_queue_size = 8192;  // 每个输出目标的队列容量(消息条数)
+  LogOverflowPolicy console_overflow = LogOverflowPolicy::DROP_NEWEST;
+  LogOverflowPolicy file_overflow = LogOverflowPolicy::BLOCK;
+  bool file_mmap = false;  // 文件输出使用预分配的内存映射分段(仅POSIX)
+  LogSyncPolicy file_sync = LogSyncPolicy::NONE;  // 文件与JSON输出flush时的策略
+  size_t file_sync_bytes = 0;  // 每写入多少字节发起一次异步msync，0为不发起
+  bool deferred_formatting = false;  // 是否由后台线程延迟格式化参数
+  bool per_thread_queues = false;  // 以每线程无锁队列代替spdlog共享线程池
+  size_t queue_size = 8192;  // 异步队列容量(消息条数)
+  LogOverflowPolicy overflow_policy = LogOverflowPolicy::BLOCK;  // 溢出策略
+  size_t overflow_timeout_ms = 0;  // BLOCK的最长等待(毫秒)，0为一直等待
+  size_t drop_report_ms = 10000;  // 输出丢弃统计的间隔(毫秒)，0为不输出
+  size_t shed_high_percent = 0;  // 队列占用达到该百分比时降载，0为不按占用
+  size_t shed_low_percent = 25;  // 占用回落到该百分比以下时恢复
+  size_t shed_latency_ms = 0;  // 记录排队超过该时长(毫秒)时降载，0为不按延迟
+  LogLevel shed_level = LogLevel::WARN;  // 降载期间的最低级别
+  LogLevel flush_level = LogLevel::ERROR;  // 该级别及以上的记录触发刷新
+  size_t flush_latency_ms = 0;  // 触发后最迟多久刷新(毫秒)，期间合并，0为立即
+  size_t flush_interval_ms = 0;  // 定期刷新的间隔(毫秒)，0为不定期刷新
+  size_t flush_bytes = 0;  // 累计写入多少字节后刷新，0为不按字节
+  size_t backend_threads = 1;  // spdlog线程池的后台线程数
+  bool handlers_on_backend = false;  // 在后台线程而非调用线程执行自定义处理器
+  bool binary_enabled = false;  // 是否启用二进制文件输出(用hert-logcat解码)
+  std::string binary_path = "hert.hlog";  // 二进制日志路径，轮转规则同文本文件
+  LogLevel binary_level = LogLevel::TRACE;  // 二进制日志级别
+  bool json_enabled = false;  // 是否启用JSON-lines文件输出
+  std::string json_path = "hert.jsonl";  // JSON日志路径，轮转规则同文本文件
+  LogLevel json_level = LogLevel::DEBUG;  // JSON日志级别
+  bool capture_std_fds = false;  // 在fd层面捕获stdout/stderr(仅POSIX)
+  LogClockSource clock_source = LogClockSource::SYSTEM;  // 时间戳时钟源
+};
+
+/**
+ * @brief 结构化日志的一个键值字段，只在日志调用期间引用值
+ */
+template<typename T>
+struct LogField
+{
+  std::string_view key;
+  const T& value;
 };
 
+/**
+ * @brief 构造结构化字段，值须为算术、枚举或字符串类型
+ */
+template<typename T>
+LogField<T> field(std::string_view key, const T& value)
+{
+  return LogField<T> {key, value};
+}
+
 /**
  * @brief 自定义日志处理器类型
  */
@@ -60,6 +340,41 @@ using LogHandler = std::function<void(LogLevel level,
                                       int line,
                                       const std::string& function)>;
 
+/**
+ * @brief 传给处理器的日志记录视图
+ *
+ * 各字段直接引用日志系统内部的缓冲区，只在处理器调用期间有效。
+ */
+struct LogRecord
+{
+  LogLevel level;
+  std::string_view message;
+  std::string_view category;  // 日志分类，未指定时为空
+  std::string_view file;  // 源文件，无位置信息时为空
+  int line;
+  std::string_view function;
+  std::chrono::system_clock::time_point time;
+  size_t thread_id;
+};
+
+/**
+ * @brief 接收结构化记录的处理器类型
+ */
+using LogRecordHandler = std::function<void(const LogRecord& record)>;
+
+/**
+ * @brief 处理器的订阅条件，不满足条件的记录不会投递给该处理器
+ */
+struct LogHandlerFilter
+{
+  LogLevel min_level = LogLevel::TRACE;  // 最低级别
+  std::string category;  // 分类前缀，"net"匹配"net"与"net.io"，为空匹配全部
+};
+
+class HertLogBackend;
+class HertLogFdCapture;
+class HertLogJsonWriter;
+
 /**
  * @brief 高性能日志系统 - 类似于log4j的功能
  *
@@ -85,42 +400,148 @@ public:
    */
   static void setLevel(LogLevel level);
 
+  /**
+   * @brief 设置分类的级别，同时作用于未单独设置级别的子分类
+   *
+   * 例如设置"net"为DEBUG后"net.io"也输出DEBUG，除非"net.io"另有设置。
+   * 分类的级别可以低于全局级别，仍受各输出目标自身级别的限制。
+   * @param category 分类名称
+   * @param level 日志级别
+   */
+  static void setCategoryLevel(std::string_view category, LogLevel level);
+
+  /**
+   * @brief 清除分类的单独设置，恢复继承上级分类或全局级别
+   */
+  static void resetCategoryLevel(std::string_view category);
+
+  /**
+   * @brief 列出已登记的调用点
+   * @param pattern 通配符模式，见setSiteState
+   */
+  static std::vector<LogSiteInfo> listSites(std::string_view pattern = "*");
+
+  /**
+   * @brief 设置匹配的调用点的开关，用于线上临时打开个别DEBUG语句
+   *
+   * 模式支持"*"与"?"通配符，依次与"文件名:行号"、"完整路径:行号"和
+   * 格式串比较，任一匹配即可，例如"net.cpp:*"或"*连接*"。规则会保留，
+   * 之后登记的调用点(如动态加载的库)同样生效。强制打开的调用点仍受各
+   * 输出目标自身级别的限制。
+   * @return 当前匹配的调用点数量
+   */
+  static std::size_t setSiteState(std::string_view pattern, LogSiteState state);
+
   /**
    * @brief 设置日志模式
+   *
+   * 语法同spdlog。常用标志由预编译的格式器处理，日期时间部分每秒只
+   * 渲染一次；含其他标志或对齐说明的模式交给spdlog的格式器。
    * @param pattern 日志格式模式
    */
   static void setPattern(const std::string& pattern);
 
   /**
    * @brief 添加自定义日志处理器
+   *
+   * 处理器列表以不可变快照发布，写日志时无锁读取；增删处理器的开销较大，
+   * 应在初始化阶段完成。
    * @param handler 处理器函数
    */
   static void addHandler(const LogHandler& handler);
 
+  /**
+   * @brief 添加接收结构化记录的处理器
+   *
+   * 所有处理器都不订阅的级别在写日志时直接跳过，不会构建记录。
+   * @param handler 处理器函数
+   * @param filter 订阅的最低级别与分类
+   */
+  static void addRecordHandler(const LogRecordHandler& handler,
+                               const LogHandlerFilter& filter = {});
+
   /**
    * @brief 清除所有自定义处理器
    */
   static void clearHandlers();
 
   /**
-   * @brief 刷新所有日志输出
+   * @brief 刷新所有日志输出，等待此前的记录写出
+   *
+   * file_sync为SYNC时同时等待文件落盘。后台线程或独立输出线程5秒内
+   * 没有写完时不再等待。
+   * @return 此前的记录均已写出并刷新时返回true，等待超时返回false
    */
-  static void flush();
+  static bool flush();
 
   /**
    * @brief 关闭日志系统
    */
   static void shutdown();
 
+  /**
+   * @brief 异步队列溢出丢失的记录数，含各输出目标独立队列丢弃的记录
+   */
+  static LogDropStats dropStats();
+
+  // ============ 崩溃飞行记录器 ============
+
+  /**
+   * @brief 启用飞行记录器，HertDump::init会自动启用
+   *
+   * 每个线程在内存中保留最近records_per_thread条记录，包括被级别过滤
+   * 的TRACE/DEBUG宏调用与初始化前的日志，单条记录占128字节。启用后
+   * 被级别过滤的宏调用也会求值参数；单独关闭的调用点仍不求值。参数
+   * 超过kFlightArgsSize字节的记录只保留格式串。容量在第一次启用时确定。
+   */
+  static void enableFlightRecorder(std::size_t records_per_thread = 4096);
+
+  /**
+   * @brief 停止记录，已有的记录仍可转储
+   */
+  static void disableFlightRecorder();
+
+  /**
+   * @brief 把飞行记录器中的记录以二进制日志格式写入fd
+   *
+   * 只调用write，不加锁也不分配内存，可在信号处理器中使用，结果可用
+   * hert-logcat或HertLogBinaryReader解码。各线程的记录依次写出，
+   * 转储期间正被改写的记录会被跳过。
+   * @return 写出的记录数
+   */
+  static std::size_t dumpFlightRecorder(int fd);
+
+  /**
+   * @brief 飞行记录器是否在记录，供宏在被过滤的分支中判断
+   */
+  static bool is_flight_recording()
+  {
+    return s_flight_recording.load(std::memory_order_relaxed);
+  }
+
   // ============ 主要日志接口 ============
 
   /**
    * @brief 输出INFO级别日志
+   *
+   * 各级别都接受fmt::runtime包装的运行时格式串，这类调用总是在调用线程
+   * 上格式化，不进入延迟格式化，格式串不必比调用活得更久。
    */
   template<typename... Args>
   static void info(fmt::format_string<Args...> format, Args&&... args)
   {
-    log_internal(LogLevel::INFO, format, std::forward<Args>(args)...);
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_INFO) {
+      log_internal(LogLevel::INFO, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void info(detail::RuntimeFormat format, Args&&... args)
+  {
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_INFO) {
+      log_runtime(LogLevel::INFO, format, args...);
+    }
   }
 
   /**
@@ -129,7 +550,18 @@ public:
   template<typename... Args>
   static void error(fmt::format_string<Args...> format, Args&&... args)
   {
-    log_internal(LogLevel::ERROR, format, std::forward<Args>(args)...);
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_ERROR) {
+      log_internal(LogLevel::ERROR, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void error(detail::RuntimeFormat format, Args&&... args)
+  {
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_ERROR) {
+      log_runtime(LogLevel::ERROR, format, args...);
+    }
   }
 
   /**
@@ -138,7 +570,18 @@ public:
   template<typename... Args>
   static void warn(fmt::format_string<Args...> format, Args&&... args)
   {
-    log_internal(LogLevel::WARN, format, std::forward<Args>(args)...);
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_WARN) {
+      log_internal(LogLevel::WARN, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void warn(detail::RuntimeFormat format, Args&&... args)
+  {
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_WARN) {
+      log_runtime(LogLevel::WARN, format, args...);
+    }
   }
 
   /**
@@ -152,13 +595,33 @@ public:
     std::abort();  // 模拟panic行为
   }
 
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void panic(detail::RuntimeFormat format, Args&&... args)
+  {
+    log_runtime(LogLevel::CRITICAL, format, args...);
+    flush();
+    std::abort();
+  }
+
   /**
    * @brief 输出DEBUG级别日志
    */
   template<typename... Args>
   static void debug(fmt::format_string<Args...> format, Args&&... args)
   {
-    log_internal(LogLevel::DEBUG, format, std::forward<Args>(args)...);
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_DEBUG) {
+      log_internal(LogLevel::DEBUG, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void debug(detail::RuntimeFormat format, Args&&... args)
+  {
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_DEBUG) {
+      log_runtime(LogLevel::DEBUG, format, args...);
+    }
   }
 
   /**
@@ -167,46 +630,254 @@ public:
   template<typename... Args>
   static void trace(fmt::format_string<Args...> format, Args&&... args)
   {
-    log_internal(LogLevel::TRACE, format, std::forward<Args>(args)...);
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_TRACE) {
+      log_internal(LogLevel::TRACE, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+    requires detail::kRuntimeFormatDistinct
+  static void trace(detail::RuntimeFormat format, Args&&... args)
+  {
+    if constexpr (HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_TRACE) {
+      log_runtime(LogLevel::TRACE, format, args...);
+    }
+  }
+
+  /**
+   * @brief 输出带键值字段的结构化日志
+   *
+   * 字段按类型原样拷贝进后端队列，由后台线程直接编码：文本输出为
+   * "消息 key=value"，JSON输出中每个字段是独立的键。例如
+   * HertLog::log_fields(LogLevel::INFO, "请求完成",
+   *                     field("path", path), field("ms", elapsed));
+   */
+  template<typename... Ts>
+  static void log_fields(LogLevel level,
+                         std::string_view message,
+                         const LogField<Ts>&... fields)
+  {
+    static_assert((detail::DeferredArg<std::decay_t<Ts>>::supported && ...),
+                  "结构化字段的值须为算术、枚举或字符串类型");
+    const bool enabled = is_initialized() && should_log(level);
+    if (!enabled && !is_flight_recording()) {
+      return;
+    }
+
+    using detail::DeferredArg;
+    using detail::DeferredStringArg;
+    const std::size_t size = DeferredStringArg::size(message)
+        + (std::size_t {0} + ...
+           + (DeferredStringArg::size(fields.key)
+              + DeferredArg<std::decay_t<Ts>>::size(fields.value)));
+    fmt::basic_memory_buffer<std::byte, detail::kMaxDeferredArgsSize> args;
+    args.resize(size);
+    [[maybe_unused]] std::byte* out =
+        DeferredStringArg::encode(args.data(), message);
+    ((out = DeferredArg<std::decay_t<Ts>>::encode(
+          DeferredStringArg::encode(out, fields.key), fields.value)),
+     ...);
+    const detail::DeferredCodec* codec = &detail::fields_codec<
+        typename DeferredArg<std::decay_t<Ts>>::decoded_type...>;
+    if (is_flight_recording()) {
+      record_flight_encoded(level,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            codec,
+                            detail::fields_format<sizeof...(Ts)>(),
+                            args.data(),
+                            size);
+    }
+    if (enabled) {
+      log_fields_encoded(level,
+                         codec,
+                         detail::fields_format<sizeof...(Ts)>(),
+                         args.data(),
+                         size);
+    }
   }
 
   // ============ 带位置信息的日志宏 ============
 
-#define HERT_LOG_INFO(format, ...) \
-  Hert::HertLog::log_with_location(Hert::LogLevel::INFO, \
-                                   __FILE__, \
-                                   __LINE__, \
-                                   __FUNCTION__, \
-                                   format, \
-                                   ##__VA_ARGS__)
-
-#define HERT_LOG_ERROR(format, ...) \
-  Hert::HertLog::log_with_location(Hert::LogLevel::ERROR, \
-                                   __FILE__, \
-                                   __LINE__, \
-                                   __FUNCTION__, \
-                                   format, \
-                                   ##__VA_ARGS__)
-
-#define HERT_LOG_WARN(format, ...) \
-  Hert::HertLog::log_with_location(Hert::LogLevel::WARN, \
-                                   __FILE__, \
-                                   __LINE__, \
-                                   __FUNCTION__, \
-                                   format, \
-                                   ##__VA_ARGS__)
-
-#define HERT_LOG_DEBUG(format, ...) \
-  Hert::HertLog::log_with_location(Hert::LogLevel::DEBUG, \
-                                   __FILE__, \
-                                   __LINE__, \
-                                   __FUNCTION__, \
-                                   format, \
-                                   ##__VA_ARGS__)
+// 每个宏展开处一份编译期常量的调用点信息，按指针传递
+#define HERT_LOG_SITE(level) \
+  []() -> const Hert::LogSite& \
+  { \
+    static constexpr Hert::LogSite hert_log_site { \
+        level, __FILE__, Hert::detail::basename(__FILE__), __LINE__}; \
+    return hert_log_site; \
+  }()
+
+// 每个宏展开处一个调用点条目：编译期常量的位置信息与可运行时开关的状态，
+// 条目在程序启动时登记到调用点注册表，格式串须为字符串字面量
+#define HERT_LOG_SITE_ENTRY(level, format) \
+  struct HertLogSiteTag \
+  { \
+    static constexpr Hert::LogSite site() \
+    { \
+      return {level, __FILE__, Hert::detail::basename(__FILE__), __LINE__}; \
+    } \
+    static constexpr const char* format_text() { return format; } \
+  }; \
+  using HertLogSiteEntry = Hert::detail::LogSiteEntry<HertLogSiteTag>
+
+// 先检查调用点开关与级别再求值参数，被过滤的调用不会计算任何参数表达式；
+// 单独关闭的调用点只需读取一次静态状态。飞行记录器启用时被级别过滤的
+// 调用改为写入记录器
+#define HERT_LOG_CALL(level, format, ...) \
+  [&, hert_function = __FUNCTION__]() \
+  { \
+    HERT_LOG_SITE_ENTRY(level, format); \
+    const Hert::LogSiteState hert_state = HertLogSiteEntry::state(); \
+    if (hert_state == Hert::LogSiteState::DEFAULT \
+            ? Hert::HertLog::is_enabled(level) \
+            : hert_state == Hert::LogSiteState::ENABLED) \
+    { \
+      Hert::HertLog::log_at_enabled( \
+          HertLogSiteEntry::site, hert_function, format, ##__VA_ARGS__); \
+    } else if (hert_state == Hert::LogSiteState::DEFAULT \
+               && Hert::HertLog::is_flight_recording()) \
+    { \
+      Hert::HertLog::record_flight_at( \
+          HertLogSiteEntry::site, hert_function, format, ##__VA_ARGS__); \
+    } \
+  }()
+
+// 分类版本：只读取分类自身的级别，不受全局级别影响
+#define HERT_CLOG_CALL(category, level, format, ...) \
+  [&, hert_function = __FUNCTION__]() \
+  { \
+    HERT_LOG_SITE_ENTRY(level, format); \
+    const Hert::LogSiteState hert_state = HertLogSiteEntry::state(); \
+    if (hert_state == Hert::LogSiteState::DEFAULT \
+            ? (category).is_enabled(level) \
+            : hert_state == Hert::LogSiteState::ENABLED) \
+    { \
+      Hert::HertLog::log_at_enabled((category), \
+                                    HertLogSiteEntry::site, \
+                                    hert_function, \
+                                    format, \
+                                    ##__VA_ARGS__); \
+    } else if (hert_state == Hert::LogSiteState::DEFAULT \
+               && Hert::HertLog::is_flight_recording()) \
+    { \
+      Hert::HertLog::record_flight_at((category), \
+                                      HertLogSiteEntry::site, \
+                                      hert_function, \
+                                      format, \
+                                      ##__VA_ARGS__); \
+    } \
+  }()
 
+// 限流版本：先判断调用点开关与级别，再由调用点自己的限流器决定是否输出，
+// 被抑制的调用不求值参数也不格式化；恢复输出时先汇总被抑制的次数
+#define HERT_LOG_LIMITED(level, limiter, admit_args, format, ...) \
+  [&, hert_function = __FUNCTION__]() \
+  { \
+    constexpr Hert::LogLevel hert_level = Hert::LogLevel::level; \
+    if constexpr (Hert::detail::level_active(hert_level)) { \
+      HERT_LOG_SITE_ENTRY(Hert::LogLevel::level, format); \
+      const Hert::LogSiteState hert_state = HertLogSiteEntry::state(); \
+      if (hert_state == Hert::LogSiteState::DEFAULT \
+              ? !Hert::HertLog::is_enabled(hert_level) \
+              : hert_state != Hert::LogSiteState::ENABLED) \
+      { \
+        return; \
+      } \
+      static constinit limiter hert_limiter; \
+      const std::uint64_t hert_suppressed = hert_limiter.admit admit_args; \
+      if (hert_suppressed == Hert::detail::kLogSuppressed) { \
+        return; \
+      } \
+      if (hert_suppressed > 0) { \
+        Hert::HertLog::log_at_enabled(HertLogSiteEntry::site, \
+                                      hert_function, \
+                                      "{} similar messages suppressed", \
+                                      hert_suppressed); \
+      } \
+      Hert::HertLog::log_at_enabled( \
+          HertLogSiteEntry::site, hert_function, format, ##__VA_ARGS__); \
+    } \
+  }()
+
+// level为不带前缀的级别名，例如 HERT_LOG_EVERY_N(WARN, 100, "重试{}", n)
+#define HERT_LOG_EVERY_N(level, n, format, ...) \
+  HERT_LOG_LIMITED( \
+      level, Hert::detail::LogEveryN, (n), format, ##__VA_ARGS__)
+
+#define HERT_LOG_FIRST_N(level, n, format, ...) \
+  HERT_LOG_LIMITED( \
+      level, Hert::detail::LogFirstN, (n), format, ##__VA_ARGS__)
+
+#define HERT_LOG_EVERY_MS(level, ms, format, ...) \
+  HERT_LOG_LIMITED( \
+      level, Hert::detail::LogEveryInterval, (ms), format, ##__VA_ARGS__)
+
+// 平均每秒最多rate条，允许连续burst条的突发
+#define HERT_LOG_RATE_LIMITED(level, rate, burst, format, ...) \
+  HERT_LOG_LIMITED(level, \
+                   Hert::detail::LogTokenBucket, \
+                   (rate, burst), \
+                   format, \
+                   ##__VA_ARGS__)
+
+#if HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_TRACE
+#  define HERT_LOG_TRACE(format, ...) \
+    HERT_LOG_CALL(Hert::LogLevel::TRACE, format, ##__VA_ARGS__)
+#  define HERT_CLOG_TRACE(category, format, ...) \
+    HERT_CLOG_CALL(category, Hert::LogLevel::TRACE, format, ##__VA_ARGS__)
+#else
+#  define HERT_LOG_TRACE(format, ...) static_cast<void>(0)
+#  define HERT_CLOG_TRACE(category, format, ...) static_cast<void>(0)
+#endif
+
+#if HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_DEBUG
+#  define HERT_LOG_DEBUG(format, ...) \
+    HERT_LOG_CALL(Hert::LogLevel::DEBUG, format, ##__VA_ARGS__)
+#  define HERT_CLOG_DEBUG(category, format, ...) \
+    HERT_CLOG_CALL(category, Hert::LogLevel::DEBUG, format, ##__VA_ARGS__)
+#else
+#  define HERT_LOG_DEBUG(format, ...) static_cast<void>(0)
+#  define HERT_CLOG_DEBUG(category, format, ...) static_cast<void>(0)
+#endif
+
+#if HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_INFO
+#  define HERT_LOG_INFO(format, ...) \
+    HERT_LOG_CALL(Hert::LogLevel::INFO, format, ##__VA_ARGS__)
+#  define HERT_CLOG_INFO(category, format, ...) \
+    HERT_CLOG_CALL(category, Hert::LogLevel::INFO, format, ##__VA_ARGS__)
+#else
+#  define HERT_LOG_INFO(format, ...) static_cast<void>(0)
+#  define HERT_CLOG_INFO(category, format, ...) static_cast<void>(0)
+#endif
+
+#if HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_WARN
+#  define HERT_LOG_WARN(format, ...) \
+    HERT_LOG_CALL(Hert::LogLevel::WARN, format, ##__VA_ARGS__)
+#  define HERT_CLOG_WARN(category, format, ...) \
+    HERT_CLOG_CALL(category, Hert::LogLevel::WARN, format, ##__VA_ARGS__)
+#else
+#  define HERT_LOG_WARN(format, ...) static_cast<void>(0)
+#  define HERT_CLOG_WARN(category, format, ...) static_cast<void>(0)
+#endif
+
+#if HERT_LOG_ACTIVE_LEVEL <= HERT_LOG_LEVEL_ERROR
+#  define HERT_LOG_ERROR(format, ...) \
+    HERT_LOG_CALL(Hert::LogLevel::ERROR, format, ##__VA_ARGS__)
+#  define HERT_CLOG_ERROR(category, format, ...) \
+    HERT_CLOG_CALL(category, Hert::LogLevel::ERROR, format, ##__VA_ARGS__)
+#else
+#  define HERT_LOG_ERROR(format, ...) static_cast<void>(0)
+#  define HERT_CLOG_ERROR(category, format, ...) static_cast<void>(0)
+#endif
+
+// PANIC必须终止程序，不受编译期级别影响
 #define HERT_LOG_PANIC(format, ...) \
-  Hert::HertLog::log_with_location_panic( \
-      __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+  Hert::HertLog::log_at_panic(HERT_LOG_SITE(Hert::LogLevel::CRITICAL), \
+                              __FUNCTION__, \
+                              format, \
+                              ##__VA_ARGS__)
 
   /**
    * @brief 带位置信息的日志输出
@@ -219,23 +890,95 @@ public:
                                 fmt::format_string<Args...> format,
                                 Args&&... args)
   {
-    if (!is_initialized() || !should_log(level)) {
+    const LogSite site {level, file, detail::basename(file), line};
+    log_at(site, function, format, std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief 在指定调用点输出日志，消息在栈上缓冲区中格式化
+   */
+  template<typename... Args>
+  static void log_at(const LogSite& site,
+                     const char* function,
+                     fmt::format_string<Args...> format,
+                     Args&&... args)
+  {
+    if (!is_initialized() || !should_log(site.level)) {
       return;
     }
+    format_at(site, function, nullptr, format, std::forward<Args>(args)...);
+  }
 
-    try {
-      std::string message = fmt::format(format, std::forward<Args>(args)...);
-      log_with_location_internal(level, file, line, function, message);
-    } catch (const std::exception& e) {
-      // 格式化错误时的安全处理
-      log_with_location_internal(LogLevel::ERROR,
-                                 file,
-                                 line,
-                                 function,
-                                 "Log format error: " + std::string(e.what()));
+  /**
+   * @brief 在指定调用点输出某个分类的日志，按分类的级别过滤
+   */
+  template<typename... Args>
+  static void log_at(const LogCategory& category,
+                     const LogSite& site,
+                     const char* function,
+                     fmt::format_string<Args...> format,
+                     Args&&... args)
+  {
+    if (!is_initialized() || !category.is_enabled(site.level)) {
+      return;
+    }
+    format_at(
+        site, function, category.name(), format, std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief 调用方已判断过调用点开关与级别，只检查日志系统是否已初始化
+   */
+  template<typename... Args>
+  static void log_at_enabled(const LogSite& site,
+                             const char* function,
+                             fmt::format_string<Args...> format,
+                             Args&&... args)
+  {
+    if (is_initialized()) {
+      format_at(site, function, nullptr, format, std::forward<Args>(args)...);
+    }
+  }
+
+  template<typename... Args>
+  static void log_at_enabled(const LogCategory& category,
+                             const LogSite& site,
+                             const char* function,
+                             fmt::format_string<Args...> format,
+                             Args&&... args)
+  {
+    if (is_initialized()) {
+      format_at(site,
+                function,
+                category.name(),
+                format,
+                std::forward<Args>(args)...);
     }
   }
 
+  /**
+   * @brief 把被过滤的调用写入飞行记录器，由宏在级别判断失败后调用
+   */
+  template<typename... Args>
+  static void record_flight_at(const LogSite& site,
+                               const char* function,
+                               fmt::format_string<Args...> format,
+                               Args&&... args)
+  {
+    record_flight(site.level, &site, function, nullptr, format, args...);
+  }
+
+  template<typename... Args>
+  static void record_flight_at(const LogCategory& category,
+                               const LogSite& site,
+                               const char* function,
+                               fmt::format_string<Args...> format,
+                               Args&&... args)
+  {
+    record_flight(
+        site.level, &site, function, category.name(), format, args...);
+  }
+
   /**
    * @brief 带位置信息的panic日志
    */
@@ -246,12 +989,20 @@ public:
                                       fmt::format_string<Args...> format,
                                       Args&&... args)
   {
-    log_with_location(LogLevel::CRITICAL,
-                      file,
-                      line,
-                      function,
-                      format,
-                      std::forward<Args>(args)...);
+    const LogSite site {LogLevel::CRITICAL, file, detail::basename(file), line};
+    log_at_panic(site, function, format, std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief 在指定调用点输出panic日志并退出程序
+   */
+  template<typename... Args>
+  static void log_at_panic(const LogSite& site,
+                           const char* function,
+                           fmt::format_string<Args...> format,
+                           Args&&... args)
+  {
+    log_at(site, function, format, std::forward<Args>(args)...);
     flush();
     std::abort();
   }
@@ -261,6 +1012,11 @@ public:
 
   /**
    * @brief 启用Qt日志重定向
+   *
+   * 每个QLoggingCategory映射为同名的Hert分类("default"对应未指定分类)，
+   * 可用setCategoryLevel单独设置级别。同时安装分类过滤器，Hert分类不
+   * 输出的级别在Qt侧直接关闭，qCDebug等宏不会格式化参数；Qt自己的
+   * 规则(QT_LOGGING_RULES等)仍先生效。
    */
   static void enableQtLogRedirect();
 
@@ -281,6 +1037,13 @@ public:
 
   /**
    * @brief 启用标准输出重定向
+   *
+   * std::cout按INFO、std::cerr按ERROR级别写入日志，每个换行结束一条
+   * 记录，std::flush/std::endl也会结束当前行；重定向期间清除cerr的
+   * unitbuf，否则每次<<都会结束一行。各线程分别拼接自己的行，
+   * 并发写入不会交错；未写完的半行在重定向关闭时只输出调用线程的部分。
+   * printf等直接写fd的输出不经过std::cout，需用LogSinkConfig::
+   * capture_std_fds在fd层面捕获。
    */
   static void enableStdRedirect();
 
@@ -294,7 +1057,20 @@ public:
    */
   static bool is_initialized() { return s_initialized.load(); }
 
+  /**
+   * @brief 判断该级别当前是否会输出，供宏在求值参数前调用
+   */
+  static bool is_enabled(LogLevel level)
+  {
+    return level >= s_current_level.load(std::memory_order_relaxed)
+        && s_initialized.load(std::memory_order_relaxed);
+  }
+
 private:
+  friend class HertLogBackend;
+  friend class HertLogFdCapture;
+  friend class HertLogJsonWriter;
+
   // 禁止实例化
   HertLog() = delete;
   ~HertLog() = delete;
@@ -304,18 +1080,62 @@ private:
   HertLog& operator=(HertLog&&) = delete;
 
   // 内部实现方法
+  template<typename... Args>
+  static void format_at(const LogSite& site,
+                        const char* function,
+                        const char* category,
+                        fmt::format_string<Args...> format,
+                        Args&&... args)
+  {
+    if (is_flight_recording()) {
+      record_flight(site.level, &site, function, category, format, args...);
+    }
+    if (log_deferred(site.level, &site, function, category, format, args...)) {
+      return;
+    }
+
+    fmt::memory_buffer message;
+    try {
+      fmt::format_to(
+          fmt::appender(message), format, std::forward<Args>(args)...);
+    } catch (const std::exception& e) {
+      // 格式化错误时的安全处理
+      message.clear();
+      fmt::format_to(
+          fmt::appender(message), "Log format error: {}", e.what());
+      log_with_location_internal(LogLevel::ERROR,
+                                 site,
+                                 function,
+                                 {message.data(), message.size()},
+                                 category);
+      return;
+    }
+    log_with_location_internal(site.level,
+                               site,
+                               function,
+                               {message.data(), message.size()},
+                               category);
+  }
+
   template<typename... Args>
   static void log_internal(LogLevel level,
                            fmt::format_string<Args...> format,
                            Args&&... args)
   {
+    if (is_flight_recording()) {
+      record_flight(level, nullptr, nullptr, nullptr, format, args...);
+    }
     if (!is_initialized() || !should_log(level)) {
       return;
     }
 
+    if (log_deferred(level, nullptr, nullptr, nullptr, format, args...)) {
+      return;
+    }
+
     try {
       std::string message = fmt::format(format, std::forward<Args>(args)...);
-      log_message_internal(level, message);
+      log_message_enabled(level, message, nullptr);
     } catch (const std::exception& e) {
       // 格式化错误时的安全处理
       log_message_internal(LogLevel::ERROR,
@@ -323,35 +1143,183 @@ private:
     }
   }
 
-  static void log_message_internal(LogLevel level, const std::string& message);
+  /**
+   * @brief 运行时格式串在调用线程上格式化，按普通文本记录
+   *
+   * 队列与飞行记录器只保存格式串指针，不能用于存储期由调用方决定的
+   * 格式串。
+   */
+  template<typename... Args>
+  static void log_runtime(LogLevel level,
+                          detail::RuntimeFormat format,
+                          const Args&... args)
+  {
+    if (!is_flight_recording() && !(is_initialized() && should_log(level))) {
+      return;
+    }
+    try {
+      const std::string message =
+          fmt::vformat(format.str, fmt::make_format_args(args...));
+      log_message_internal(level, message);
+    } catch (const std::exception& e) {
+      log_message_internal(LogLevel::ERROR,
+                           "Log format error: " + std::string(e.what()));
+    }
+  }
+
+  /**
+   * @brief 延迟格式化：只把原始参数拷贝进后端队列
+   *
+   * 队列中只保存格式串指针，格式串须为字符串字面量等静态存储。
+   * @return 未启用延迟格式化或参数无法延迟时返回false，由调用方直接格式化
+   */
+  template<typename... Args>
+  static bool log_deferred(LogLevel level,
+                           const LogSite* site,
+                           const char* function,
+                           const char* category,
+                           fmt::string_view format,
+                           const Args&... args)
+  {
+    using Encoder = detail::DeferredArgs<std::decay_t<Args>...>;
+    if constexpr (!Encoder::supported) {
+      return false;
+    } else {
+      if (!s_deferred_formatting.load(std::memory_order_relaxed)
+          || !Encoder::preserves(format))
+      {
+        return false;
+      }
+      const std::size_t size = Encoder::size(args...);
+      if (size > detail::kMaxDeferredArgsSize) {
+        return false;
+      }
+      std::byte buffer[detail::kMaxDeferredArgsSize];
+      Encoder::encode(buffer, args...);
+      // 按解码后的类型实例化，各种字符串参数共用同一组编解码函数
+      return enqueue_deferred(
+          level,
+          site,
+          function,
+          category,
+          &detail::deferred_codec<typename detail::DeferredArg<
+              std::decay_t<Args>>::decoded_type...>,
+          format,
+          sizeof...(Args) > 0 ? buffer : nullptr,
+          size);
+    }
+  }
+
+  /**
+   * @brief 按延迟格式化的编码把调用写入飞行记录器
+   *
+   * 参数无法编码、超过kFlightArgsSize或字符指针配{:p}时只记下格式串。
+   */
+  template<typename... Args>
+  static void record_flight(LogLevel level,
+                            const LogSite* site,
+                            const char* function,
+                            const char* category,
+                            fmt::string_view format,
+                            const Args&... args)
+  {
+    using Encoder = detail::DeferredArgs<std::decay_t<Args>...>;
+    if constexpr (Encoder::supported) {
+      const std::size_t size = Encoder::size(args...);
+      if (size <= detail::kFlightArgsSize && Encoder::preserves(format)) {
+        std::byte buffer[detail::kFlightArgsSize];
+        Encoder::encode(buffer, args...);
+        record_flight_encoded(
+            level,
+            site,
+            function,
+            category,
+            &detail::deferred_codec<typename detail::DeferredArg<
+                std::decay_t<Args>>::decoded_type...>,
+            format,
+            sizeof...(Args) > 0 ? buffer : nullptr,
+            size);
+        return;
+      }
+    }
+    record_flight_encoded(
+        level, site, function, category, nullptr, format, nullptr, 0);
+  }
+
+  static void record_flight_encoded(LogLevel level,
+                                    const LogSite* site,
+                                    const char* function,
+                                    const char* category,
+                                    const detail::DeferredCodec* codec,
+                                    fmt::string_view format,
+                                    const std::byte* args,
+                                    std::size_t args_size);
+  static bool enqueue_deferred(LogLevel level,
+                               const LogSite* site,
+                               const char* function,
+                               const char* category,
+                               const detail::DeferredCodec* codec,
+                               fmt::string_view format,
+                               const std::byte* args,
+                               std::size_t args_size);
+  static void log_fields_encoded(LogLevel level,
+                                 const detail::DeferredCodec* codec,
+                                 fmt::string_view format,
+                                 const std::byte* args,
+                                 std::size_t args_size);
+  static void log_message_internal(LogLevel level,
+                                   std::string_view message,
+                                   const char* category = nullptr);
+  // 级别已由调用方(如按分类)判断过
+  static void log_message_enabled(LogLevel level,
+                                  std::string_view message,
+                                  const char* category);
   static void log_with_location_internal(LogLevel level,
-                                         const char* file,
-                                         int line,
+                                         const LogSite& site,
                                          const char* function,
-                                         const std::string& message);
+                                         std::string_view message,
+                                         const char* category = nullptr);
+  static void refresh_levels();
+  static void set_shed_level(LogLevel level);
   static bool should_log(LogLevel level);
   static spdlog::level::level_enum convert_log_level(LogLevel level);
-  static void call_custom_handlers(LogLevel level,
-                                   const std::string& message,
-                                   const std::string& file,
-                                   int line,
-                                   const std::string& function);
+  static bool has_custom_handlers(LogLevel level)
+  {
+    return level >= s_handlers_level.load(std::memory_order_relaxed);
+  }
+  static void call_custom_handlers(const LogRecord& record);
 
   // 静态成员变量
   static std::shared_ptr<spdlog::logger> s_logger;
-  static std::vector<LogHandler> s_handlers;
-  static std::mutex s_handlers_mutex;
+  struct HandlerList;
+  // 替换后的旧快照等读取它的线程都离开后才释放
+  static std::atomic<const HandlerList*> s_handlers;
+  static std::atomic<LogLevel> s_handlers_level;  // 所有处理器订阅的最低级别
+  static std::mutex s_handlers_mutex;  // 仅串行化处理器的增删
+  static std::atomic<bool> s_handlers_on_backend;
   static std::atomic<bool> s_initialized;
-  static std::atomic<LogLevel> s_current_level;
+  static std::atomic<LogLevel> s_current_level;  // 生效级别，供前端判断
+  static std::atomic<LogLevel> s_configured_level;  // setLevel设置的级别
+  static std::atomic<LogLevel> s_shed_level;  // 降载期间的下限，平时为TRACE
+  static std::mutex s_level_mutex;
+  static std::atomic<bool> s_deferred_formatting;
+  static std::atomic<bool> s_flight_recording;
+  static std::unique_ptr<HertLogBackend> s_backend;
+  static std::unique_ptr<HertLogFdCapture> s_fd_capture;
 
 #ifdef QT_CORE_LIB
+  static void qtCategoryFilter(QLoggingCategory* category);
+  static void refresh_qt_categories();
+
   static QtMessageHandler s_original_qt_handler;
+  static QLoggingCategory::CategoryFilter s_original_qt_filter;
   static std::atomic<bool> s_qt_redirect_enabled;
 #endif
 
   static std::atomic<bool> s_std_redirect_enabled;
   static std::streambuf* s_original_cout_buf;
   static std::streambuf* s_original_cerr_buf;
+  static std::ios_base::fmtflags s_original_cerr_unitbuf;
 
   // 自定义流缓冲区用于重定向标准输出
   class LogStreamBuf;
@@ -0,0 +1,546 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+namespace Hert::detail
+{
+
+/**
+ * @brief 单条延迟格式化记录参数区的最大字节数
+ *
+ * 编码后超出该长度的调用退回到调用线程上直接格式化。
+ */
+inline constexpr std::size_t kMaxDeferredArgsSize = 256;
+
+/**
+ * @brief 飞行记录器每条记录内联的参数区字节数
+ *
+ * 超出的调用只记下格式串，运行时文本截断到该长度。
+ */
+inline constexpr std::size_t kFlightArgsSize = 56;
+
+/**
+ * @brief 后端格式化函数：按编码时的参数类型解码参数区并格式化到缓冲区
+ */
+using DeferredFormatFn = void (*)(fmt::string_view format,
+                                  const std::byte* args,
+                                  fmt::memory_buffer& out);
+
+/**
+ * @brief 二进制日志序列化函数：把参数区转写为带类型标记的紧凑编码
+ */
+using DeferredSerializeFn = void (*)(const std::byte* args,
+                                     fmt::memory_buffer& out);
+
+/**
+ * @brief 二进制日志中参数的类型标记
+ */
+enum class BinaryArgType : std::uint8_t
+{
+  SIGNED = 0,  // zigzag变长整数
+  UNSIGNED = 1,  // 变长整数
+  FLOAT = 2,  // 4字节
+  DOUBLE = 3,  // 8字节
+  BOOL = 4,  // 1字节
+  CHAR = 5,  // 变长整数
+  STRING = 6,  // 变长长度 + 内容
+};
+
+inline void write_varint(fmt::memory_buffer& out, std::uint64_t value)
+{
+  while (value >= 0x80U) {
+    out.push_back(static_cast<char>((value & 0x7FU) | 0x80U));
+    value >>= 7U;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline std::uint64_t zigzag_encode(std::int64_t value)
+{
+  return (static_cast<std::uint64_t>(value) << 1U)
+      ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t zigzag_decode(std::uint64_t value)
+{
+  return static_cast<std::int64_t>(value >> 1U)
+      ^ -static_cast<std::int64_t>(value & 1U);
+}
+
+template<typename T>
+void write_raw(fmt::memory_buffer& out, const T& value)
+{
+  const auto* bytes = reinterpret_cast<const char*>(&value);
+  out.append(bytes, bytes + sizeof(T));
+}
+
+/**
+ * @brief 按解码后的类型写入一个带标记的二进制参数
+ */
+template<typename T>
+void write_binary_arg(fmt::memory_buffer& out, const T& value)
+{
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    out.push_back(static_cast<char>(BinaryArgType::STRING));
+    write_varint(out, value.size());
+    out.append(value.data(), value.data() + value.size());
+  } else if constexpr (std::is_enum_v<T>) {
+    // 离线解码时没有枚举的formatter，按底层整数保存
+    write_binary_arg(out, static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::is_same_v<T, bool>) {
+    out.push_back(static_cast<char>(BinaryArgType::BOOL));
+    out.push_back(static_cast<char>(value ? 1 : 0));
+  } else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, char8_t>
+                       || std::is_same_v<T, char16_t>
+                       || std::is_same_v<T, char32_t>
+                       || std::is_same_v<T, wchar_t>)
+  {
+    out.push_back(static_cast<char>(BinaryArgType::CHAR));
+    write_varint(out,
+                 static_cast<std::uint64_t>(
+                     static_cast<std::make_unsigned_t<T>>(value)));
+  } else if constexpr (std::is_same_v<T, float>) {
+    out.push_back(static_cast<char>(BinaryArgType::FLOAT));
+    write_raw(out, value);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    out.push_back(static_cast<char>(BinaryArgType::DOUBLE));
+    write_raw(out, static_cast<double>(value));
+  } else if constexpr (std::is_signed_v<T>) {
+    out.push_back(static_cast<char>(BinaryArgType::SIGNED));
+    write_varint(out, zigzag_encode(static_cast<std::int64_t>(value)));
+  } else {
+    out.push_back(static_cast<char>(BinaryArgType::UNSIGNED));
+    write_varint(out, static_cast<std::uint64_t>(value));
+  }
+}
+
+/**
+ * @brief 一种参数类型组合的编解码入口
+ */
+struct DeferredCodec
+{
+  DeferredFormatFn format;
+  DeferredSerializeFn serialize;
+  DeferredSerializeFn json = nullptr;  // 结构化字段的JSON编码，普通记录为空
+};
+
+/**
+ * @brief 参数编解码特征，未特化的类型不支持延迟格式化
+ */
+template<typename T, typename = void>
+struct DeferredArg
+{
+  static constexpr bool supported = false;
+};
+
+/**
+ * @brief 算术与枚举类型：按值拷贝
+ */
+template<typename T>
+struct DeferredArg<
+    T,
+    std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+{
+  static constexpr bool supported = true;
+  using decoded_type = T;
+
+  static std::size_t size(const T& /*value*/) { return sizeof(T); }
+
+  static std::byte* encode(std::byte* out, const T& value)
+  {
+    std::memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+  }
+
+  static T decode(const std::byte*& in)
+  {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+  }
+};
+
+/**
+ * @brief 字符串类型：拷贝长度与内容，后端以string_view读取
+ */
+struct DeferredStringArg
+{
+  static constexpr bool supported = true;
+  using decoded_type = std::string_view;
+
+  static std::size_t size(std::string_view value)
+  {
+    return sizeof(std::uint32_t) + value.size();
+  }
+
+  static std::size_t size(const char* value)
+  {
+    // 空指针交给fmt在调用线程上报告格式化错误
+    return value ? size(std::string_view(value)) : kMaxDeferredArgsSize + 1;
+  }
+
+  static std::byte* encode(std::byte* out, std::string_view value)
+  {
+    const auto length = static_cast<std::uint32_t>(value.size());
+    std::memcpy(out, &length, sizeof(length));
+    std::memcpy(out + sizeof(length), value.data(), value.size());
+    return out + sizeof(length) + value.size();
+  }
+
+  static std::string_view decode(const std::byte*& in)
+  {
+    std::uint32_t length = 0;
+    std::memcpy(&length, in, sizeof(length));
+    std::string_view value(reinterpret_cast<const char*>(in + sizeof(length)),
+                           length);
+    in += sizeof(length) + length;
+    return value;
+  }
+};
+
+template<>
+struct DeferredArg<const char*> : DeferredStringArg
+{
+};
+
+template<>
+struct DeferredArg<char*> : DeferredStringArg
+{
+};
+
+template<>
+struct DeferredArg<std::string> : DeferredStringArg
+{
+};
+
+template<>
+struct DeferredArg<std::string_view> : DeferredStringArg
+{
+};
+
+template<>
+struct DeferredArg<fmt::string_view> : DeferredStringArg
+{
+  static std::size_t size(fmt::string_view value)
+  {
+    return DeferredStringArg::size(
+        std::string_view(value.data(), value.size()));
+  }
+
+  static std::byte* encode(std::byte* out, fmt::string_view value)
+  {
+    return DeferredStringArg::encode(
+        out, std::string_view(value.data(), value.size()));
+  }
+};
+
+/**
+ * @brief 格式串中是否有以p为类型的替换域
+ *
+ * 字符指针按字符串拷贝，解码后不再是指针，{:p}只能在调用线程上格式化。
+ * 不区分替换域对应哪个参数，误判只会让调用退回到直接格式化。
+ */
+constexpr bool has_pointer_spec(std::string_view format)
+{
+  for (std::size_t i = 0; i < format.size(); ++i) {
+    if (format[i] != '{') {
+      continue;
+    }
+    if (i + 1 < format.size() && format[i + 1] == '{') {
+      ++i;  // 转义的花括号
+      continue;
+    }
+    // 宽度与精度可以是嵌套的替换域，找到与之配对的右花括号
+    std::size_t depth = 1;
+    std::size_t end = i + 1;
+    for (; end < format.size(); ++end) {
+      if (format[end] == '{') {
+        ++depth;
+      } else if (format[end] == '}' && --depth == 0) {
+        break;
+      }
+    }
+    if (end < format.size() && format[end - 1] == 'p') {
+      return true;
+    }
+    i = end;
+  }
+  return false;
+}
+
+/**
+ * @brief 一组参数的编码规则
+ */
+template<typename... Ts>
+struct DeferredArgs
+{
+  static constexpr bool supported = (DeferredArg<Ts>::supported && ...);
+  static constexpr bool has_char_pointer =
+      ((std::is_same_v<Ts, const char*> || std::is_same_v<Ts, char*>) || ...);
+
+  /**
+   * @brief 编码是否保持格式串的含义，字符指针配{:p}时不能延迟
+   */
+  static bool preserves(fmt::string_view format)
+  {
+    if constexpr (has_char_pointer) {
+      return !has_pointer_spec(std::string_view(format.data(), format.size()));
+    } else {
+      return true;
+    }
+  }
+
+  template<typename... Us>
+  static std::size_t size(const Us&... values)
+  {
+    return (std::size_t {0} + ... + DeferredArg<Ts>::size(values));
+  }
+
+  template<typename... Us>
+  static void encode([[maybe_unused]] std::byte* out, const Us&... values)
+  {
+    ((out = DeferredArg<Ts>::encode(out, values)), ...);
+  }
+};
+
+/**
+ * @brief 后端格式化入口，每种参数类型组合实例化一次
+ */
+template<typename... Ts>
+void format_deferred(fmt::string_view format,
+                     const std::byte* args,
+                     fmt::memory_buffer& out)
+{
+  const std::byte* cursor = args;
+  // 花括号初始化保证按从左到右的顺序解码
+  std::tuple<typename DeferredArg<Ts>::decoded_type...> values {
+      DeferredArg<Ts>::decode(cursor)...};
+  (void)cursor;
+  std::apply(
+      [&](const auto&... decoded)
+      {
+        fmt::vformat_to(
+            fmt::appender(out), format, fmt::make_format_args(decoded...));
+      },
+      values);
+}
+
+/**
+ * @brief 二进制日志序列化入口：参数个数后接各个带标记的参数
+ */
+template<typename... Ts>
+void serialize_deferred(const std::byte* args, fmt::memory_buffer& out)
+{
+  const std::byte* cursor = args;
+  std::tuple<typename DeferredArg<Ts>::decoded_type...> values {
+      DeferredArg<Ts>::decode(cursor)...};
+  (void)cursor;
+  write_varint(out, sizeof...(Ts));
+  std::apply([&](const auto&... decoded)
+             { (write_binary_arg(out, decoded), ...); },
+             values);
+}
+
+template<typename... Ts>
+inline constexpr DeferredCodec deferred_codec {&format_deferred<Ts...>,
+                                               &serialize_deferred<Ts...>};
+
+// ============ 结构化字段 ============
+
+/**
+ * @brief 以JSON字符串字面量的形式写入文本，含引号与转义
+ */
+inline void append_json_string(fmt::memory_buffer& out, std::string_view value)
+{
+  out.push_back('"');
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        out.append(std::string_view("\\\""));
+        break;
+      case '\\':
+        out.append(std::string_view("\\\\"));
+        break;
+      case '\n':
+        out.append(std::string_view("\\n"));
+        break;
+      case '\r':
+        out.append(std::string_view("\\r"));
+        break;
+      case '\t':
+        out.append(std::string_view("\\t"));
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20U) {
+          fmt::format_to(fmt::appender(out),
+                         "\\u{:04x}",
+                         static_cast<unsigned>(static_cast<unsigned char>(c)));
+        } else {
+          out.push_back(c);
+        }
+        break;
+    }
+  }
+  out.push_back('"');
+}
+
+/**
+ * @brief 按解码后的类型写入一个JSON值
+ */
+template<typename T>
+void write_json_value(fmt::memory_buffer& out, const T& value)
+{
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    append_json_string(out, value);
+  } else if constexpr (std::is_enum_v<T>) {
+    write_json_value(out, static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::is_same_v<T, bool>) {
+    out.append(value ? std::string_view("true") : std::string_view("false"));
+  } else if constexpr (std::is_same_v<T, char>) {
+    append_json_string(out, std::string_view(&value, 1));
+  } else if constexpr (std::is_floating_point_v<T>) {
+    if (std::isfinite(value)) {
+      fmt::format_to(fmt::appender(out), "{}", value);
+    } else {
+      out.append(std::string_view("null"));  // JSON没有NaN与无穷
+    }
+  } else {
+    // 其余字符类型按码点输出
+    const fmt::format_int text(
+        static_cast<std::conditional_t<std::is_signed_v<T>,
+                                       std::int64_t,
+                                       std::uint64_t>>(value));
+    out.append(text.data(), text.data() + text.size());
+  }
+}
+
+/**
+ * @brief 按logfmt规则写入一个值，含空白、引号或等号的字符串加引号
+ */
+template<typename T>
+void write_text_value(fmt::memory_buffer& out, const T& value)
+{
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    const bool quote = value.empty()
+        || value.find_first_of(" =\"\\\t\r\n") != std::string_view::npos;
+    if (quote) {
+      append_json_string(out, value);
+    } else {
+      out.append(value);
+    }
+  } else if constexpr (std::is_enum_v<T>) {
+    write_text_value(out, static_cast<std::underlying_type_t<T>>(value));
+  } else {
+    fmt::format_to(fmt::appender(out), "{}", value);
+  }
+}
+
+/**
+ * @brief 结构化记录的参数区：消息文本后依次是各字段的键与值
+ */
+template<typename T>
+void format_field(const std::byte*& cursor, fmt::memory_buffer& out)
+{
+  const std::string_view key = DeferredStringArg::decode(cursor);
+  const T value = DeferredArg<T>::decode(cursor);
+  out.push_back(' ');
+  out.append(key);
+  out.push_back('=');
+  write_text_value(out, value);
+}
+
+template<typename T>
+void json_field(const std::byte*& cursor, fmt::memory_buffer& out)
+{
+  const std::string_view key = DeferredStringArg::decode(cursor);
+  const T value = DeferredArg<T>::decode(cursor);
+  out.push_back(',');
+  append_json_string(out, key);
+  out.push_back(':');
+  write_json_value(out, value);
+}
+
+template<typename T>
+void serialize_field(const std::byte*& cursor, fmt::memory_buffer& out)
+{
+  write_binary_arg(out, DeferredStringArg::decode(cursor));
+  write_binary_arg(out, DeferredArg<T>::decode(cursor));
+}
+
+/**
+ * @brief 文本输出："消息 key=value key=value"，格式串不使用
+ */
+template<typename... Ts>
+void format_fields(fmt::string_view /*format*/,
+                   const std::byte* args,
+                   fmt::memory_buffer& out)
+{
+  const std::byte* cursor = args;
+  out.append(DeferredStringArg::decode(cursor));
+  (format_field<Ts>(cursor, out), ...);
+}
+
+/**
+ * @brief JSON输出："msg":"消息","key":value...，不含外层花括号
+ */
+template<typename... Ts>
+void json_fields(const std::byte* args, fmt::memory_buffer& out)
+{
+  const std::byte* cursor = args;
+  out.append(std::string_view("\"msg\":"));
+  append_json_string(out, DeferredStringArg::decode(cursor));
+  (json_field<Ts>(cursor, out), ...);
+}
+
+/**
+ * @brief 二进制输出：消息与各字段的键、值依次作为参数，配合fields_format
+ */
+template<typename... Ts>
+void serialize_fields(const std::byte* args, fmt::memory_buffer& out)
+{
+  const std::byte* cursor = args;
+  write_varint(out, 1 + 2 * sizeof...(Ts));
+  write_binary_arg(out, DeferredStringArg::decode(cursor));
+  (serialize_field<Ts>(cursor, out), ...);
+}
+
+/**
+ * @brief N个字段的格式串"{} {}={} {}={}..."，供二进制日志离线还原文本
+ */
+template<std::size_t N>
+inline constexpr std::array<char, 2 + 6 * N> fields_format_text = []()
+{
+  std::array<char, 2 + 6 * N> text {};
+  constexpr std::string_view field(" {}={}");
+  text[0] = '{';
+  text[1] = '}';
+  for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t j = 0; j < field.size(); ++j) {
+      text[2 + i * field.size() + j] = field[j];
+    }
+  }
+  return text;
+}();
+
+template<std::size_t N>
+constexpr fmt::string_view fields_format()
+{
+  return {fields_format_text<N>.data(), fields_format_text<N>.size()};
+}
+
+template<typename... Ts>
+inline constexpr DeferredCodec fields_codec {
+    &format_fields<Ts...>, &serialize_fields<Ts...>, &json_fields<Ts...>};
+
+}  // namespace Hert::detail
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+
+struct gzFile_s;
+
+namespace Hert
+{
+
+/**
+ * @brief 二进制日志文件格式
+ *
+ * 每次打开文件写入时以8字节文件头开始一个新会话，会话内依次是：
+ * - 调用点记录：类型、编号、分类、文件、行号、函数名、格式串，
+ *   每个调用点只写一次；
+ * - 日志记录：类型、调用点编号、级别、相对上一条记录的时间差、
+ *   线程ID，随后是参数个数与各个带类型标记的参数。
+ * 整数均为LEB128变长编码，有符号数先做zigzag变换，字符串为长度加内容。
+ */
+namespace binlog
+{
+inline constexpr char kMagic[7] = {'H', 'E', 'R', 'T', 'L', 'O', 'G'};
+inline constexpr std::uint8_t kVersion = 1;
+inline constexpr std::size_t kHeaderSize = sizeof(kMagic) + 1;
+
+enum class RecordType : std::uint8_t
+{
+  SITE = 1,
+  RECORD = 2,
+};
+}  // namespace binlog
+
+/**
+ * @brief 从二进制日志中解码出的一条记录
+ */
+struct BinaryLogEntry
+{
+  LogLevel level = LogLevel::INFO;
+  std::string message;
+  std::string category;
+  std::string file;  // 源文件完整路径，无位置信息时为空
+  int line = 0;
+  std::string function;
+  std::chrono::system_clock::time_point time;
+  size_t thread_id = 0;
+};
+
+/**
+ * @brief 二进制日志读取器
+ *
+ * 按写入顺序逐条解码记录，文件尾部未写完整的记录视为文件结束。
+ * 可以直接读取压缩器生成的.gz归档。
+ */
+class HertLogBinaryReader
+{
+public:
+  /**
+   * @brief 打开二进制日志文件
+   * @throws std::runtime_error 文件无法打开或不是二进制日志
+   */
+  explicit HertLogBinaryReader(const std::string& path);
+  ~HertLogBinaryReader();
+
+  HertLogBinaryReader(const HertLogBinaryReader&) = delete;
+  HertLogBinaryReader& operator=(const HertLogBinaryReader&) = delete;
+  HertLogBinaryReader(HertLogBinaryReader&&) = delete;
+  HertLogBinaryReader& operator=(HertLogBinaryReader&&) = delete;
+
+  /**
+   * @brief 读取下一条记录
+   * @return 已到文件末尾时返回false
+   * @throws std::runtime_error 文件内容损坏
+   */
+  bool next(BinaryLogEntry& entry);
+
+private:
+  struct Site
+  {
+    std::string category;
+    std::string file;
+    int line;
+    std::string function;
+    std::string format;
+  };
+
+  int get();
+  int peek();
+  bool read(void* data, std::size_t size);
+  bool read_header();
+  bool read_site();
+  bool read_record(BinaryLogEntry& entry);
+  bool read_varint(std::uint64_t& value);
+  bool read_string(std::string& value);
+
+  gzFile_s* m_input;
+  std::vector<Site> m_sites;
+  std::int64_t m_last_time_ns = 0;
+};
+
+}  // namespace Hert
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace Hert::detail
+{
+
+/**
+ * @brief 限流器返回该值表示本次调用被抑制
+ *
+ * 其他返回值为上次输出以来被抑制的调用次数，非零时先输出一条汇总。
+ * 各限流器只含原子变量，作为常量初始化的局部静态变量放在每个调用点。
+ */
+inline constexpr std::uint64_t kLogSuppressed =
+    std::numeric_limits<std::uint64_t>::max();
+
+inline std::int64_t log_limit_now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief 每n次调用输出一次：第1、n+1、2n+1...次
+ */
+struct LogEveryN
+{
+  std::atomic<std::uint64_t> count {0};
+
+  std::uint64_t admit(std::uint64_t n)
+  {
+    const std::uint64_t index = count.fetch_add(1, std::memory_order_relaxed);
+    if (n <= 1) {
+      return 0;
+    }
+    if (index % n != 0) {
+      return kLogSuppressed;
+    }
+    return index == 0 ? 0 : n - 1;
+  }
+};
+
+/**
+ * @brief 只输出前n次调用
+ */
+struct LogFirstN
+{
+  std::atomic<std::uint64_t> count {0};
+
+  std::uint64_t admit(std::uint64_t n)
+  {
+    // 超过n次后只读不写，避免热循环中反复争用缓存行
+    if (count.load(std::memory_order_relaxed) >= n) {
+      return kLogSuppressed;
+    }
+    return count.fetch_add(1, std::memory_order_relaxed) < n ? 0
+                                                             : kLogSuppressed;
+  }
+};
+
+/**
+ * @brief 每个时间间隔内最多输出一次
+ */
+struct LogEveryInterval
+{
+  std::atomic<std::int64_t> next_ns {std::numeric_limits<std::int64_t>::min()};
+  std::atomic<std::uint64_t> suppressed {0};
+
+  std::uint64_t admit(std::int64_t interval_ms)
+  {
+    const std::int64_t now = log_limit_now_ns();
+    std::int64_t next = next_ns.load(std::memory_order_relaxed);
+    // 多个线程同时到期时只有交换成功的一个输出
+    if (now < next
+        || !next_ns.compare_exchange_strong(
+            next, now + interval_ms * 1000000, std::memory_order_relaxed))
+    {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return kLogSuppressed;
+    }
+    return suppressed.exchange(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief 令牌桶：平均每秒rate次，最多连续burst次
+ *
+ * 以GCRA算法实现，只需一个理论到达时间的原子变量：每次输出把它推后
+ * 一个发放间隔，超前当前时间超过burst个间隔时拒绝。rate不大于0时
+ * 只输出最初的burst次。
+ */
+struct LogTokenBucket
+{
+  // 间隔与容差的上限，远超进程寿命，与单调时钟相加也不会溢出
+  static constexpr std::int64_t kNeverNs =
+      std::numeric_limits<std::int64_t>::max() / 4;
+
+  std::atomic<std::int64_t> tat_ns {std::numeric_limits<std::int64_t>::min()};
+  std::atomic<std::uint64_t> suppressed {0};
+
+  std::uint64_t admit(double rate, std::uint64_t burst)
+  {
+    const std::uint64_t extra = burst > 0 ? burst - 1 : 0;
+    // rate不大于0或小到间隔超出上限时，把上限均分给burst次，之后不再发放
+    const std::int64_t interval = rate > 1e9 / static_cast<double>(kNeverNs)
+        ? static_cast<std::int64_t>(1e9 / rate)
+        : kNeverNs
+            / static_cast<std::int64_t>(
+                std::min<std::uint64_t>(extra + 1, kNeverNs));
+    // 容差饱和到上限，突发量再大也只是相当于不限流
+    const std::int64_t tolerance = interval > 0
+            && extra > static_cast<std::uint64_t>(kNeverNs / interval)
+        ? kNeverNs
+        : interval * static_cast<std::int64_t>(extra);
+    const std::int64_t now = log_limit_now_ns();
+    std::int64_t tat = tat_ns.load(std::memory_order_relaxed);
+    while (true) {
+      const std::int64_t start = tat > now ? tat : now;
+      if (start - now > tolerance) {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return kLogSuppressed;
+      }
+      if (tat_ns.compare_exchange_weak(
+              tat, start + interval, std::memory_order_relaxed))
+      {
+        return suppressed.exchange(0, std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+}  // namespace Hert::detail
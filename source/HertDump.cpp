@@ -1,31 +1,80 @@
+#include <array>
 #include <atomic>
+#include <climits>
 #include <csignal>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
 
 #include "Hert/HertDump.hpp"
 
 #include <cpptrace/cpptrace.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Hert/HertLog.hpp"
 
 std::function<void()> HertDump::crashCallback = nullptr;
 bool HertDump::initialized = false;
 std::string HertDump::coreDumpDir;
 
+namespace
+{
+// 飞行记录路径由 setCoreDumpDir 生成，信号处理器中不能拼接字符串。
+// 两份定长缓冲轮流写入，写完后才发布其下标，信号处理器只读已发布的一份
+std::array<std::array<char, PATH_MAX>, 2> flightRecordPaths {};
+std::atomic<int> flightRecordIndex {-1};  // -1 表示不写飞行记录
+std::mutex flightRecordMutex;  // 串行化写入方，避免改写正在发布的一份
+
+const char* publishedFlightRecordPath()
+{
+  const int index = flightRecordIndex.load(std::memory_order_acquire);
+  return index < 0 ? nullptr
+                   : flightRecordPaths[static_cast<std::size_t>(index)].data();
+}
+}  // anonymous namespace
+
 void HertDump::init(const std::string& coreDir)
 {
   if (initialized) {
     return;
   }
-  setCoreDumpDir(coreDir);
   installSignalHandlers();
   initialized = true;
+  setCoreDumpDir(coreDir);
 }
 
 void HertDump::setCoreDumpDir(const std::string& dir)
 {
   coreDumpDir = dir;
-  if (!dir.empty()) {
-    std::filesystem::create_directories(dir);
+  bool recording = false;
+  {
+    std::lock_guard<std::mutex> lock(flightRecordMutex);
+    const int current = flightRecordIndex.load(std::memory_order_relaxed);
+    int next = -1;
+    if (!dir.empty()) {
+      std::filesystem::create_directories(dir);
+      const std::string path =
+          dir + "/flight_" + std::to_string(::getpid()) + ".hlog";
+      if (path.size() < PATH_MAX) {
+        // 写入未发布的一份，信号处理器此时仍读旧的一份
+        next = current == 0 ? 1 : 0;
+        auto& buffer = flightRecordPaths[static_cast<std::size_t>(next)];
+        std::memcpy(buffer.data(), path.c_str(), path.size() + 1);
+      }
+    }
+    flightRecordIndex.store(next, std::memory_order_release);
+    recording = next >= 0;
+  }
+  if (!initialized) {
+    return;  // init时再按目录决定是否记录
+  }
+  // 没有转储目录时记录也无处写出，不必承担记录的开销
+  if (!recording) {
+    Hert::HertLog::disableFlightRecorder();
+  } else {
+    Hert::HertLog::enableFlightRecorder();
   }
 }
 
@@ -57,11 +106,25 @@ void HertDump::signalHandler(int signum)
     // 已经在处理信号，直接退出，防止递归
     _exit(128 + signum);
   }
+  // 先写出飞行记录器，只用到异步信号安全的调用，不受后续步骤失败影响
+  const char* flightRecordPath = publishedFlightRecordPath();
+  if (flightRecordPath != nullptr) {
+    const int fd = ::open(flightRecordPath,
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+    if (fd >= 0) {
+      Hert::HertLog::dumpFlightRecorder(fd);
+      ::close(fd);
+    }
+  }
   std::cerr << "\n[HertDump] 崩溃信号: " << signum << std::endl;
   printStacktrace();
   if (!coreDumpDir.empty()) {
     std::string corePath = coreDumpDir + "/core_" + std::to_string(::getpid());
     std::cerr << "[HertDump] core dump 路径: " << corePath << std::endl;
+    if (flightRecordPath != nullptr) {
+      std::cerr << "[HertDump] 飞行记录: " << flightRecordPath << std::endl;
+    }
   }
   if (crashCallback) {
     crashCallback();
@@ -1,13 +1,33 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <thread>
 
 #include "Hert/HertLog.hpp"
 
+#include "HertLogArchiver.hpp"
+#include "HertLogAsyncSink.hpp"
+#include "HertLogBackend.hpp"
+#include "HertLogCategory.hpp"
+#include "HertLogDedupSink.hpp"
+#include "HertLogDiagnostics.hpp"
+#include "HertLogFdCapture.hpp"
+#include "HertLogFlight.hpp"
+#include "HertLogFlushSink.hpp"
+#include "HertLogFormatter.hpp"
+#include "HertLogSite.hpp"
+#include "HertLogMmapSink.hpp"
+#include "HertLogQt.hpp"
+#include "HertLogRotatingSink.hpp"
+
 #include <spdlog/async.h>
 #include <spdlog/common.h>
+#include <spdlog/details/os.h>
 #include <spdlog/pattern_formatter.h>
+#include <spdlog/sinks/ansicolor_sink.h>
 #include <spdlog/sinks/basic_file_sink.h>
-#include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 namespace Hert
@@ -16,13 +36,209 @@ namespace Hert
 // ============ 静态成员变量定义 ============
 
 std::shared_ptr<spdlog::logger> HertLog::s_logger = nullptr;
-std::vector<LogHandler> HertLog::s_handlers;
+/**
+ * @brief 处理器列表快照，发布后不再修改
+ */
+struct HertLog::HandlerList
+{
+  struct Entry
+  {
+    LogRecordHandler handler;
+    LogHandlerFilter filter;
+  };
+  std::vector<Entry> entries;
+};
+
+std::atomic<const HertLog::HandlerList*> HertLog::s_handlers {nullptr};
+std::atomic<LogLevel> HertLog::s_handlers_level {LogLevel::OFF};
 std::mutex HertLog::s_handlers_mutex;
+std::atomic<bool> HertLog::s_handlers_on_backend {false};
 std::atomic<bool> HertLog::s_initialized {false};
 std::atomic<LogLevel> HertLog::s_current_level {LogLevel::INFO};
+std::atomic<LogLevel> HertLog::s_configured_level {LogLevel::INFO};
+std::atomic<LogLevel> HertLog::s_shed_level {LogLevel::TRACE};
+std::mutex HertLog::s_level_mutex;
+std::atomic<bool> HertLog::s_deferred_formatting {false};
+std::atomic<bool> HertLog::s_flight_recording {false};
+std::unique_ptr<HertLogBackend> HertLog::s_backend = nullptr;
+std::unique_ptr<HertLogFdCapture> HertLog::s_fd_capture = nullptr;
 
 namespace
 {
+// 按单条记录的平均字节数把queue_size换算为每线程队列的容量
+constexpr std::size_t kAverageRecordBytes = 128;
+// flush等待线程池写出的最长时间，与后端和独立输出线程一致
+constexpr auto kFlushTimeout = std::chrono::seconds(5);
+
+// 每个线程一个进出标记，奇数表示线程正在访问后端、日志器或处理器快照。
+// 只由所属线程写入，独占缓存行；槽位登记在只追加的链表中从不释放，
+// 线程退出后留给新线程复用
+struct alignas(64) ProducerSlot
+{
+  std::atomic<std::uint64_t> epoch {0};
+  std::atomic<bool> in_use {false};
+  ProducerSlot* next = nullptr;  // 登记后不再修改
+};
+
+std::atomic<ProducerSlot*> g_producer_slots {nullptr};
+
+struct ProducerHandle
+{
+  ~ProducerHandle()
+  {
+    if (slot) {
+      slot->in_use.store(false, std::memory_order_release);
+      slot = nullptr;
+    }
+  }
+  ProducerSlot* slot = nullptr;
+  std::size_t depth = 0;  // 嵌套的进入次数，只有最外层改变标记
+};
+
+thread_local ProducerHandle t_producer;
+
+ProducerSlot* acquire_producer_slot()
+{
+  for (ProducerSlot* slot = g_producer_slots.load(std::memory_order_acquire);
+       slot;
+       slot = slot->next)
+  {
+    bool expected = false;
+    if (!slot->in_use.load(std::memory_order_relaxed)
+        && slot->in_use.compare_exchange_strong(
+            expected, true, std::memory_order_acquire))
+    {
+      return slot;
+    }
+  }
+  auto* slot = new ProducerSlot();
+  slot->in_use.store(true, std::memory_order_relaxed);
+  slot->next = g_producer_slots.load(std::memory_order_relaxed);
+  while (!g_producer_slots.compare_exchange_weak(slot->next,
+                                                 slot,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed))
+  {
+  }
+  return slot;
+}
+
+// 进入时以顺序一致的写入置为奇数，之后再读取s_initialized或处理器快照；
+// shutdown与替换快照的一方先写后扫描各线程的标记，两侧至少有一侧能看到
+// 对方。热路径只写本线程的缓存行，不触及进程共享的计数
+class ProducerGuard
+{
+public:
+  ProducerGuard()
+  {
+    if (t_producer.depth++ == 0) {
+      ProducerSlot* slot = t_producer.slot;
+      if (slot == nullptr) {
+        slot = t_producer.slot = acquire_producer_slot();
+      }
+      slot->epoch.store(slot->epoch.load(std::memory_order_relaxed) + 1);
+    }
+  }
+  ~ProducerGuard()
+  {
+    if (--t_producer.depth == 0) {
+      ProducerSlot* slot = t_producer.slot;
+      slot->epoch.store(slot->epoch.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    }
+  }
+
+  ProducerGuard(const ProducerGuard&) = delete;
+  ProducerGuard& operator=(const ProducerGuard&) = delete;
+  ProducerGuard(ProducerGuard&&) = delete;
+  ProducerGuard& operator=(ProducerGuard&&) = delete;
+};
+
+// 等待此刻处在进入状态的其他线程离开，调用线程自己不等待
+void wait_for_producers()
+{
+  for (ProducerSlot* slot = g_producer_slots.load(std::memory_order_acquire);
+       slot;
+       slot = slot->next)
+  {
+    if (slot == t_producer.slot) {
+      continue;  // 处理器中调用shutdown时不等待自己
+    }
+    const std::uint64_t epoch = slot->epoch.load();
+    if (epoch % 2 == 0) {
+      continue;
+    }
+    while (slot->epoch.load(std::memory_order_acquire) == epoch) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// 已被替换的处理器快照，连同替换时仍处在进入状态的线程及其标记；
+// 这些线程都离开后才释放。只在持有s_handlers_mutex时访问
+struct RetiredSnapshot
+{
+  std::shared_ptr<const void> snapshot;
+  std::vector<std::pair<ProducerSlot*, std::uint64_t>> readers;
+};
+
+std::vector<RetiredSnapshot> g_retired_snapshots;
+
+// 调用方已用顺序一致的写入换下快照，此后扫描到的奇数标记覆盖所有
+// 可能仍在读取旧快照的线程
+void retire_snapshot(std::shared_ptr<const void> snapshot)
+{
+  RetiredSnapshot retired {std::move(snapshot), {}};
+  for (ProducerSlot* slot = g_producer_slots.load(std::memory_order_acquire);
+       slot;
+       slot = slot->next)
+  {
+    const std::uint64_t epoch = slot->epoch.load();
+    if (epoch % 2 != 0) {
+      retired.readers.emplace_back(slot, epoch);
+    }
+  }
+  g_retired_snapshots.push_back(std::move(retired));
+}
+
+// 释放读者都已离开的快照
+void reclaim_snapshots()
+{
+  const auto released = [](const RetiredSnapshot& retired)
+  {
+    return std::all_of(retired.readers.begin(),
+                       retired.readers.end(),
+                       [](const auto& reader)
+                       {
+                         return reader.first->epoch.load(
+                                    std::memory_order_acquire)
+                             != reader.second;
+                       });
+  };
+  g_retired_snapshots.erase(std::remove_if(g_retired_snapshots.begin(),
+                                           g_retired_snapshots.end(),
+                                           released),
+                            g_retired_snapshots.end());
+}
+
+// 在调用线程上构建处理器记录
+LogRecord make_caller_record(LogLevel level,
+                             std::string_view message,
+                             const char* category,
+                             const char* file,
+                             int line,
+                             const char* function)
+{
+  return LogRecord {level,
+                    message,
+                    category ? category : "",
+                    file ? file : "",
+                    line,
+                    function ? function : "",
+                    std::chrono::system_clock::now(),
+                    spdlog::details::os::thread_id()};
+}
+
 // 延迟初始化的配置获取函数
 LogSinkConfig& get_config()
 {
@@ -35,57 +251,110 @@ LogSinkConfig& get_config()
 
 #ifdef QT_CORE_LIB
 QtMessageHandler HertLog::s_original_qt_handler = nullptr;
+QLoggingCategory::CategoryFilter HertLog::s_original_qt_filter = nullptr;
 std::atomic<bool> HertLog::s_qt_redirect_enabled {false};
 #endif
 
 std::atomic<bool> HertLog::s_std_redirect_enabled {false};
 std::streambuf* HertLog::s_original_cout_buf = nullptr;
 std::streambuf* HertLog::s_original_cerr_buf = nullptr;
+std::ios_base::fmtflags HertLog::s_original_cerr_unitbuf {};
 std::unique_ptr<HertLog::LogStreamBuf> HertLog::s_cout_redirect = nullptr;
 std::unique_ptr<HertLog::LogStreamBuf> HertLog::s_cerr_redirect = nullptr;
 
 // ============ 自定义流缓冲区实现 ============
 
+// 不设置put区：std::cout是全局共享的，put区指针无法按线程区分，多个
+// 线程同时写会互相踩踏。改为在xsputn中整段写入调用线程自己的行缓冲，
+// 按换行切分为记录，不同线程的输出不会拼进同一行
 class HertLog::LogStreamBuf : public std::streambuf
 {
 public:
   explicit LogStreamBuf(LogLevel level)
       : m_level(level)
+      , m_id(s_next_id.fetch_add(1, std::memory_order_relaxed))
   {
   }
 
+  ~LogStreamBuf() override { sync(); }
+
+  LogStreamBuf(const LogStreamBuf&) = delete;
+  LogStreamBuf& operator=(const LogStreamBuf&) = delete;
+  LogStreamBuf(LogStreamBuf&&) = delete;
+  LogStreamBuf& operator=(LogStreamBuf&&) = delete;
+
 protected:
   int overflow(int c) override
   {
     if (c != EOF) {
-      m_buffer += static_cast<char>(c);
-      if (c == '\n') {
-        flush_buffer();
-      }
+      const char ch = static_cast<char>(c);
+      append(&ch, 1);
     }
     return c;
   }
 
+  std::streamsize xsputn(const char* s, std::streamsize n) override
+  {
+    append(s, static_cast<std::size_t>(n));
+    return n;
+  }
+
   int sync() override
   {
-    flush_buffer();
+    std::string& line = thread_line();
+    if (!line.empty()) {
+      HertLog::log_message_internal(m_level, line);
+      line.clear();
+    }
     return 0;
   }
 
 private:
-  void flush_buffer()
+  // 每个线程为cout和cerr各保留一行，owner记录所属的缓冲区，
+  // 重定向重新启用后丢弃旧缓冲区残留的半行
+  struct ThreadLine
+  {
+    std::uint64_t owner = 0;
+    std::string text;
+  };
+
+  std::string& thread_line()
   {
-    if (!m_buffer.empty() && m_buffer.back() == '\n') {
-      m_buffer.pop_back();  // 移除换行符
+    thread_local std::array<ThreadLine, 2> lines;
+    ThreadLine& line = lines[m_level >= LogLevel::ERROR ? 1 : 0];
+    if (line.owner != m_id) {
+      line.owner = m_id;
+      line.text.clear();
     }
-    if (!m_buffer.empty()) {
-      HertLog::log_message_internal(m_level, m_buffer);
-      m_buffer.clear();
+    return line.text;
+  }
+
+  void append(const char* s, std::size_t n)
+  {
+    std::string& line = thread_line();
+    std::string_view rest(s, n);
+    for (auto pos = rest.find('\n'); pos != std::string_view::npos;
+         pos = rest.find('\n'))
+    {
+      // 行缓冲为空时直接以输入中的整行作为消息，省去一次拷贝
+      if (line.empty()) {
+        if (pos > 0) {
+          HertLog::log_message_internal(m_level, rest.substr(0, pos));
+        }
+      } else {
+        line.append(rest.substr(0, pos));
+        HertLog::log_message_internal(m_level, line);
+        line.clear();
+      }
+      rest.remove_prefix(pos + 1);
     }
+    line.append(rest);
   }
 
+  static inline std::atomic<std::uint64_t> s_next_id {1};
+
   LogLevel m_level;
-  std::string m_buffer;
+  std::uint64_t m_id;
 };
 
 // ============ 核心实现方法 ============
@@ -99,19 +368,57 @@ void HertLog::initialize(const LogSinkConfig& config)
   s_config = config;
 
   try {
-    // 创建异步日志线程池
-    if (!spdlog::get("async_pool")) {
-      spdlog::init_thread_pool(8192, 1);  // 队列大小8192，1个后台线程
+    // 二进制输出保存原始参数，总是使用延迟格式化
+    const bool deferred = config.deferred_formatting || config.binary_enabled;
+
+    // 延迟格式化、后台处理器、JSON输出、非阻塞的溢出策略、自动降载、
+    // 合并刷新、TSC时钟与fd捕获都由每线程队列后端实现
+    const bool use_backend = config.per_thread_queues || deferred
+        || config.handlers_on_backend || config.json_enabled
+        || config.overflow_policy != LogOverflowPolicy::BLOCK
+        || config.overflow_timeout_ms > 0 || config.shed_high_percent > 0
+        || config.shed_latency_ms > 0 || config.flush_latency_ms > 0
+        || config.flush_interval_ms > 0 || config.flush_bytes > 0
+        || config.clock_source != LogClockSource::SYSTEM
+        || config.capture_std_fds;
+
+    // 创建异步日志线程池（使用每线程队列时由HertLogBackend代替）
+    if (!use_backend && !spdlog::get("async_pool")) {
+      spdlog::init_thread_pool(std::max<size_t>(config.queue_size, 1),
+                               std::max<size_t>(config.backend_threads, 1));
     }
 
     std::vector<spdlog::sink_ptr> sinks;
 
+    // 各文件输出共用一个压缩线程，随最后一个使用它的sink一起销毁
+    std::shared_ptr<HertLogArchiver> archiver;
+    if (config.compress_rotated) {
+      archiver = std::make_shared<HertLogArchiver>();
+    }
+
+#if HERT_HAS_FD_CAPTURE
+    // fd 1被捕获后，控制台改写捕获前的标准输出
+    if (config.capture_std_fds) {
+      s_fd_capture = std::make_unique<HertLogFdCapture>();
+    }
+#endif
+
     // 配置控制台输出
     if (config.console_enabled) {
-      auto console_sink =
-          std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+      spdlog::sink_ptr console_sink;
+#if HERT_HAS_FD_CAPTURE
+      if (s_fd_capture) {
+        console_sink = std::make_shared<
+            spdlog::sinks::ansicolor_sink<spdlog::details::console_mutex>>(
+            s_fd_capture->console_file(), spdlog::color_mode::automatic);
+      }
+#endif
+      if (!console_sink) {
+        console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+      }
       console_sink->set_level(convert_log_level(config.console_level));
-      console_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v");
+      console_sink->set_formatter(std::make_unique<HertPatternFormatter>(
+          "[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v"));
       sinks.push_back(console_sink);
     }
 
@@ -123,27 +430,130 @@ void HertLog::initialize(const LogSinkConfig& config)
         std::filesystem::create_directories(log_path.parent_path());
       }
 
-      auto file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
-          config.file_path, config.max_file_size, config.max_files);
+      spdlog::sink_ptr file_sink;
+#if HERT_HAS_MMAP_SINK
+      if (config.file_mmap) {
+        // 按max_file_size预分配分段，切换分段不重命名文件
+        file_sink = std::make_shared<HertMmapFileSink>(config.file_path,
+                                                       config.max_file_size,
+                                                       config.max_files,
+                                                       config.rotation_period,
+                                                       config.file_sync,
+                                                       config.file_sync_bytes,
+                                                       archiver);
+      }
+#endif
+      if (!file_sink) {
+        // 轮转时只交换预先打开的文件，重命名与压缩在辅助线程完成
+        file_sink = std::make_shared<HertRotatingFileSink>(
+            config.file_path,
+            config.max_file_size,
+            config.max_files,
+            config.rotation_period,
+            config.file_sync,
+            archiver);
+      }
       file_sink->set_level(convert_log_level(config.file_level));
-      file_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+      file_sink->set_formatter(std::make_unique<HertPatternFormatter>(
+          "[%Y-%m-%d %H:%M:%S.%e] [%l] %v"));
       sinks.push_back(file_sink);
     }
 
-    // 创建异步日志器
-    s_logger = std::make_shared<spdlog::async_logger>(
-        "hert_logger",
-        sinks.begin(),
-        sinks.end(),
-        spdlog::thread_pool(),
-        spdlog::async_overflow_policy::block);
+    // 控制台与文件各自折叠连续重复的记录
+    if (config.dedup_window_ms > 0) {
+      for (auto& sink : sinks) {
+        auto dedup = std::make_shared<HertDedupSink>(
+            sink, std::chrono::milliseconds(config.dedup_window_ms));
+        dedup->set_level(sink->level());
+        sink = std::move(dedup);
+      }
+    }
+
+    // 各输出目标由自己的线程写入，慢的终端不拖住文件，反之亦然
+    if (config.sink_workers) {
+      for (std::size_t i = 0; i < sinks.size(); ++i) {
+        const bool is_console = config.console_enabled && i == 0;
+        sinks[i] = std::make_shared<HertAsyncSink>(
+            sinks[i],
+            config.sink_queue_size,
+            is_console ? config.console_overflow : config.file_overflow,
+            std::chrono::milliseconds(config.overflow_timeout_ms));
+      }
+    }
+
+    if (use_backend) {
+      // 同步日志器只作为sink容器，由后端线程写入
+      s_logger = std::make_shared<spdlog::logger>(
+          "hert_logger", sinks.begin(), sinks.end());
+      std::unique_ptr<HertLogBinaryWriter> binary_writer;
+      if (config.binary_enabled) {
+        binary_writer =
+            std::make_unique<HertLogBinaryWriter>(config.binary_path,
+                                                  config.binary_level,
+                                                  config.max_file_size,
+                                                  config.max_files,
+                                                  archiver);
+      }
+      std::unique_ptr<HertLogJsonWriter> json_writer;
+      if (config.json_enabled) {
+        // JSON行由写入器完整拼好，sink只负责原样落盘与轮转
+        auto json_sink =
+            std::make_shared<HertRotatingFileSink>(config.json_path,
+                                                   config.max_file_size,
+                                                   config.max_files,
+                                                   config.rotation_period,
+                                                   config.file_sync,
+                                                   archiver);
+        json_sink->set_formatter(std::make_unique<HertPatternFormatter>("%v"));
+        json_writer = std::make_unique<HertLogJsonWriter>(
+            std::move(json_sink), config.json_level);
+      }
+      s_backend = std::make_unique<HertLogBackend>(
+          s_logger,
+          config.queue_size * kAverageRecordBytes,
+          config.overflow_policy,
+          std::chrono::milliseconds(config.overflow_timeout_ms),
+          std::chrono::milliseconds(config.drop_report_ms),
+          LogShedConfig {
+              static_cast<double>(config.shed_high_percent) / 100,
+              static_cast<double>(config.shed_low_percent) / 100,
+              std::chrono::milliseconds(config.shed_latency_ms),
+              config.shed_level},
+          LogFlushConfig {config.flush_level,
+                          std::chrono::milliseconds(config.flush_latency_ms),
+                          std::chrono::milliseconds(config.flush_interval_ms),
+                          config.flush_bytes},
+          config.clock_source,
+          std::move(binary_writer),
+          std::move(json_writer));
+    } else {
+      // 屏障放在最后，工作线程到达时前面的sink都已写出并刷新
+      sinks.push_back(std::make_shared<HertFlushTicketSink>(
+          std::max<size_t>(config.backend_threads, 1),
+          convert_log_level(config.flush_level)));
+      // 创建异步日志器
+      s_logger = std::make_shared<spdlog::async_logger>(
+          "hert_logger",
+          sinks.begin(),
+          sinks.end(),
+          spdlog::thread_pool(),
+          spdlog::async_overflow_policy::block);
+    }
 
     s_logger->set_level(
         spdlog::level::trace);  // 设置为最低级别，由sink控制具体级别
-    s_logger->flush_on(spdlog::level::err);  // 错误级别自动刷新
+    if (!use_backend) {
+      // 后端按flush_*配置合并刷新，spdlog线程池只能逐条刷新
+      s_logger->flush_on(convert_log_level(config.flush_level));
+    }
 
     // 注册为默认日志器
     spdlog::set_default_logger(s_logger);
+    if (config.dedup_window_ms > 0) {
+      // 定期刷新让重复停止后的汇总在窗口到期后写出，随spdlog::shutdown停止
+      spdlog::flush_every(std::chrono::ceil<std::chrono::seconds>(
+          std::chrono::milliseconds(config.dedup_window_ms)));
+    }
 
     // 设置全局日志级别为配置中的最低级别
     LogLevel min_level = LogLevel::OFF;
@@ -153,53 +563,185 @@ void HertLog::initialize(const LogSinkConfig& config)
     if (config.file_enabled) {
       min_level = std::min(min_level, config.file_level);
     }
+    if (config.binary_enabled) {
+      min_level = std::min(min_level, config.binary_level);
+    }
+    if (config.json_enabled) {
+      min_level = std::min(min_level, config.json_level);
+    }
     if (min_level != LogLevel::OFF) {
-      s_current_level.store(min_level);
+      s_configured_level.store(min_level);
     }
 
+    s_deferred_formatting.store(deferred);
+    // 延迟格式化的消息只在后台线程才有文本
+    s_handlers_on_backend.store(config.handlers_on_backend || deferred);
     s_initialized.store(true);
+    refresh_levels();
+
+#if HERT_HAS_FD_CAPTURE
+    if (s_fd_capture) {
+      s_fd_capture->start();
+    }
+#endif
 
     // 输出初始化成功消息
     info("HertLog initialized successfully");
+    if (s_backend && s_backend->clock_source() != config.clock_source) {
+      warn("TSC clock is not reliable on this CPU, using system_clock");
+    }
 
   } catch (const std::exception& e) {
-    std::cerr << "Failed to initialize HertLog: " << e.what() << '\n';
+    detail::diagnostics() << "Failed to initialize HertLog: " << e.what()
+                          << '\n';
     throw;
   }
 }
 
 void HertLog::setLevel(LogLevel level)
 {
-  s_current_level.store(level);
-  if (s_logger) {
-    s_logger->set_level(convert_log_level(level));
+  // 日志器保持trace，级别只在前端判断，分类才能单独低于全局级别
+  s_configured_level.store(level);
+  refresh_levels();
+}
+
+void HertLog::setCategoryLevel(std::string_view category, LogLevel level)
+{
+  detail::LogCategoryRegistry::instance().set_level(category, level);
+#ifdef QT_CORE_LIB
+  refresh_qt_categories();
+#endif
+}
+
+void HertLog::resetCategoryLevel(std::string_view category)
+{
+  detail::LogCategoryRegistry::instance().set_level(category, std::nullopt);
+#ifdef QT_CORE_LIB
+  refresh_qt_categories();
+#endif
+}
+
+std::vector<LogSiteInfo> HertLog::listSites(std::string_view pattern)
+{
+  return detail::LogSiteRegistry::instance().list(pattern);
+}
+
+std::size_t HertLog::setSiteState(std::string_view pattern, LogSiteState state)
+{
+  return detail::LogSiteRegistry::instance().set_state(pattern, state);
+}
+
+void HertLog::set_shed_level(LogLevel level)
+{
+  s_shed_level.store(level);
+  refresh_levels();
+}
+
+void HertLog::refresh_levels()
+{
+  {
+    // 降载期间全局与各分类的生效级别都不低于降载级别
+    std::lock_guard<std::mutex> lock(s_level_mutex);
+    const LogLevel floor = s_shed_level.load();
+    s_current_level.store(std::max(s_configured_level.load(), floor));
+    detail::LogCategoryRegistry::instance().set_root_level(
+        s_configured_level.load(), floor, s_initialized.load());
   }
+#ifdef QT_CORE_LIB
+  // Qt的过滤器回调在Qt的锁内执行，不能在持有s_level_mutex时触发
+  refresh_qt_categories();
+#endif
 }
 
 void HertLog::setPattern(const std::string& pattern)
 {
-  if (s_logger) {
-    s_logger->set_pattern(pattern);
+  const ProducerGuard guard;
+  if (s_initialized.load() && s_logger) {
+    s_logger->set_formatter(std::make_unique<HertPatternFormatter>(pattern));
   }
 }
 
 void HertLog::addHandler(const LogHandler& handler)
+{
+  // 旧接口需要std::string参数，只有使用它的处理器承担拷贝
+  addRecordHandler(
+      [handler](const LogRecord& record)
+      {
+        handler(record.level,
+                std::string(record.message),
+                std::string(record.file),
+                record.line,
+                std::string(record.function));
+      });
+}
+
+void HertLog::addRecordHandler(const LogRecordHandler& handler,
+                               const LogHandlerFilter& filter)
 {
   std::lock_guard<std::mutex> lock(s_handlers_mutex);
-  s_handlers.push_back(handler);
+  const HandlerList* current = s_handlers.load(std::memory_order_relaxed);
+  auto next = current ? std::make_unique<HandlerList>(*current)
+                      : std::make_unique<HandlerList>();
+  next->entries.push_back(HandlerList::Entry {handler, filter});
+
+  LogLevel min_level = LogLevel::OFF;
+  for (const auto& entry : next->entries) {
+    min_level = std::min(min_level, entry.filter.min_level);
+  }
+
+  s_handlers_level.store(min_level, std::memory_order_relaxed);
+  // 旧快照在正在调用它的线程返回后释放
+  const HandlerList* previous = s_handlers.exchange(next.release());
+  if (previous) {
+    retire_snapshot(std::shared_ptr<const HandlerList>(previous));
+  }
+  reclaim_snapshots();
 }
 
 void HertLog::clearHandlers()
 {
   std::lock_guard<std::mutex> lock(s_handlers_mutex);
-  s_handlers.clear();
+  s_handlers_level.store(LogLevel::OFF, std::memory_order_relaxed);
+  const HandlerList* previous = s_handlers.exchange(nullptr);
+  if (previous) {
+    retire_snapshot(std::shared_ptr<const HandlerList>(previous));
+  }
+  reclaim_snapshots();
 }
 
-void HertLog::flush()
+bool HertLog::flush()
 {
+  const ProducerGuard guard;
+  if (!s_initialized.load()) {
+    return true;
+  }
+  bool complete = true;
+  if (s_backend) {
+    complete = s_backend->flush();
+  } else if (s_logger) {
+    // 异步日志器的flush只是入队，由屏障sink等待工作线程写完并刷新
+    complete = HertFlushTicketSink::flush_logger(*s_logger, kFlushTimeout);
+  }
   if (s_logger) {
-    s_logger->flush();
+    complete = HertAsyncSink::sync_all(s_logger->sinks()) && complete;
   }
+  return complete;
+}
+
+LogDropStats HertLog::dropStats()
+{
+  const ProducerGuard guard;
+  if (!s_initialized.load()) {
+    return {};
+  }
+  if (s_backend) {
+    return s_backend->drop_stats();
+  }
+  LogDropStats stats;
+  if (s_logger) {
+    HertAsyncSink::add_drops(stats, s_logger->sinks());
+  }
+  return stats;
 }
 
 void HertLog::shutdown()
@@ -215,6 +757,20 @@ void HertLog::shutdown()
 #ifdef QT_CORE_LIB
   disableQtLogRedirect();
 #endif
+#if HERT_HAS_FD_CAPTURE
+  // 捕获到的剩余输出要在后端停止前入队
+  if (s_fd_capture) {
+    s_fd_capture->stop();
+  }
+#endif
+
+  // 不再接受新记录，等已进入的调用离开后才能销毁后端与日志器
+  s_initialized.store(false);
+  wait_for_producers();
+
+  // 停止后端线程，排空队列中剩余的记录
+  s_deferred_formatting.store(false);
+  s_backend.reset();
 
   // 刷新并关闭日志器
   if (s_logger) {
@@ -225,15 +781,73 @@ void HertLog::shutdown()
   // 关闭spdlog
   spdlog::shutdown();
 
+  // 控制台sink已随日志器销毁，可以关闭它写入的流
+  s_fd_capture.reset();
+
   // 清除处理器
   clearHandlers();
 
-  s_initialized.store(false);
+  s_shed_level.store(LogLevel::TRACE);
+  refresh_levels();
+}
+
+void HertLog::enableFlightRecorder(std::size_t records_per_thread)
+{
+  HertLogFlightRecorder::configure(records_per_thread);
+  s_flight_recording.store(true);
 }
 
-void HertLog::log_message_internal(LogLevel level, const std::string& message)
+void HertLog::disableFlightRecorder()
 {
-  if (!should_log(level)) {
+  s_flight_recording.store(false);
+}
+
+std::size_t HertLog::dumpFlightRecorder(int fd)
+{
+  return HertLogFlightRecorder::dump(fd);
+}
+
+void HertLog::record_flight_encoded(LogLevel level,
+                                    const LogSite* site,
+                                    const char* function,
+                                    const char* category,
+                                    const detail::DeferredCodec* codec,
+                                    fmt::string_view format,
+                                    const std::byte* args,
+                                    std::size_t args_size)
+{
+  HertLogFlightRecorder::record(
+      level, site, function, category, codec, format, args, args_size);
+}
+
+void HertLog::log_message_internal(LogLevel level,
+                                   std::string_view message,
+                                   const char* category)
+{
+  if (is_flight_recording()) {
+    HertLogFlightRecorder::record_text(level, category, message);
+  }
+  if (should_log(level)) {
+    log_message_enabled(level, message, category);
+  }
+}
+
+void HertLog::log_message_enabled(LogLevel level,
+                                  std::string_view message,
+                                  const char* category)
+{
+  const ProducerGuard guard;
+  if (!s_initialized.load()) {
+    return;
+  }
+  if (s_backend) {
+    s_backend->push_formatted(level, category, nullptr, nullptr, message);
+    if (!s_handlers_on_backend.load(std::memory_order_relaxed)
+        && has_custom_handlers(level))
+    {
+      call_custom_handlers(make_caller_record(
+          level, message, category, nullptr, 0, nullptr));
+    }
     return;
   }
 
@@ -262,64 +876,102 @@ void HertLog::log_message_internal(LogLevel level, const std::string& message)
     }
   }
 
-  // 调用自定义处理器
-  call_custom_handlers(level, message, "", 0, "");
+  // 调用自定义处理器，没有处理器订阅该级别时不构建记录
+  if (has_custom_handlers(level)) {
+    call_custom_handlers(
+        make_caller_record(level, message, category, nullptr, 0, nullptr));
+  }
 }
 
 void HertLog::log_with_location_internal(LogLevel level,
-                                         const char* file,
-                                         int line,
+                                         const LogSite& site,
                                          const char* function,
-                                         const std::string& message)
+                                         std::string_view message,
+                                         const char* category)
 {
-  if (!should_log(level)) {
+  // 级别、分类与调用点开关都已由调用方判断
+  const ProducerGuard guard;
+  if (!is_initialized()) {
     return;
   }
 
-  if (s_logger) {
-    // 构建包含位置信息的消息
-    std::string formatted_message;
-    if (file && line > 0 && function) {
-      // 提取文件名（不包含路径）
-      std::string filename = file;
-      size_t last_slash = filename.find_last_of("/\\");
-      if (last_slash != std::string::npos) {
-        filename = filename.substr(last_slash + 1);
-      }
+  if (s_backend) {
+    s_backend->push_formatted(level, category, &site, function, message);
+    if (!s_handlers_on_backend.load(std::memory_order_relaxed)
+        && has_custom_handlers(level))
+    {
+      call_custom_handlers(make_caller_record(
+          level, message, category, site.file, site.line, function));
+    }
+    return;
+  }
 
-      formatted_message =
-          fmt::format("[{}:{}] [{}] {}", filename, line, function, message);
-    } else {
-      formatted_message = message;
+  if (s_logger) {
+    // 位置前缀与消息拼接在栈上缓冲区中，不产生堆分配
+    fmt::memory_buffer line;
+    if (site.line > 0 && function) {
+      detail::append_location(
+          line, category, site.basename, site.line, function);
     }
+    line.append(message.data(), message.data() + message.size());
+    // 调用点随记录传给sink，折叠重复时据此区分
+    s_logger->log(spdlog::source_loc {site.file, site.line, function},
+                  convert_log_level(level),
+                  spdlog::string_view_t(line.data(), line.size()));
+  }
 
-    switch (level) {
-      case LogLevel::TRACE:
-        s_logger->trace(formatted_message);
-        break;
-      case LogLevel::DEBUG:
-        s_logger->debug(formatted_message);
-        break;
-      case LogLevel::INFO:
-        s_logger->info(formatted_message);
-        break;
-      case LogLevel::WARN:
-        s_logger->warn(formatted_message);
-        break;
-      case LogLevel::ERROR:
-        s_logger->error(formatted_message);
-        break;
-      case LogLevel::CRITICAL:
-        s_logger->critical(formatted_message);
-        break;
-      default:
-        break;
+  // 调用自定义处理器，没有处理器订阅该级别时不构建记录
+  if (has_custom_handlers(level)) {
+    call_custom_handlers(make_caller_record(
+        level, message, category, site.file, site.line, function));
+  }
+}
+
+bool HertLog::enqueue_deferred(LogLevel level,
+                               const LogSite* site,
+                               const char* function,
+                               const char* category,
+                               const detail::DeferredCodec* codec,
+                               fmt::string_view format,
+                               const std::byte* args,
+                               std::size_t args_size)
+{
+  const ProducerGuard guard;
+  return s_initialized.load() && s_backend
+      && s_backend->push_deferred(
+          level, site, function, category, codec, format, args, args_size);
+}
+
+void HertLog::log_fields_encoded(LogLevel level,
+                                 const detail::DeferredCodec* codec,
+                                 fmt::string_view format,
+                                 const std::byte* args,
+                                 std::size_t args_size)
+{
+  // 结构化记录总是以原始字段入队，与是否延迟格式化普通日志无关
+  const ProducerGuard guard;
+  if (!s_initialized.load()) {
+    return;
+  }
+  if (s_backend
+      && s_backend->push_deferred(
+          level, nullptr, nullptr, nullptr, codec, format, args, args_size))
+  {
+    if (!s_handlers_on_backend.load(std::memory_order_relaxed)
+        && has_custom_handlers(level))
+    {
+      fmt::memory_buffer text;
+      codec->format(format, args, text);
+      call_custom_handlers(make_caller_record(
+          level, {text.data(), text.size()}, nullptr, nullptr, 0, nullptr));
     }
+    return;
   }
 
-  // 调用自定义处理器
-  call_custom_handlers(
-      level, message, file ? file : "", line, function ? function : "");
+  // 没有后端或记录过大时在调用线程上生成文本
+  fmt::memory_buffer text;
+  codec->format(format, args, text);
+  log_message_enabled(level, {text.data(), text.size()}, nullptr);
 }
 
 bool HertLog::should_log(LogLevel level)
@@ -349,21 +1001,29 @@ spdlog::level::level_enum HertLog::convert_log_level(LogLevel level)
   }
 }
 
-void HertLog::call_custom_handlers(LogLevel level,
-                                   const std::string& message,
-                                   const std::string& file,
-                                   int line,
-                                   const std::string& function)
+void HertLog::call_custom_handlers(const LogRecord& record)
 {
-  std::lock_guard<std::mutex> lock(s_handlers_mutex);
-  for (const auto& handler : s_handlers) {
+  // 处在进入状态期间读到的快照不会被释放，慢处理器也不会阻塞增删处理器的
+  // 线程；读取不修改任何共享计数
+  const ProducerGuard guard;
+  const HandlerList* handlers = s_handlers.load();
+  if (handlers == nullptr) {
+    return;
+  }
+  for (const auto& entry : handlers->entries) {
+    if (record.level < entry.filter.min_level
+        || !detail::category_matches(entry.filter.category, record.category))
+    {
+      continue;
+    }
     try {
-      handler(level, message, file, line, function);
+      entry.handler(record);
     } catch (const std::exception& e) {
-      // 处理器异常时输出到stderr，避免递归
-      std::cerr << "Exception in log handler: " << e.what() << '\n';
+      // 处理器异常直接写诊断输出，不经可能已重定向的cerr，避免递归
+      detail::diagnostics() << "Exception in log handler: " << e.what()
+                            << '\n';
     } catch (...) {
-      std::cerr << "Unknown exception in log handler\n";
+      detail::diagnostics() << "Unknown exception in log handler\n";
     }
   }
 }
@@ -372,6 +1032,27 @@ void HertLog::call_custom_handlers(LogLevel level,
 
 #ifdef QT_CORE_LIB
 
+namespace
+{
+LogLevel qt_level(QtMsgType type)
+{
+  switch (type) {
+    case QtDebugMsg:
+      return LogLevel::DEBUG;
+    case QtInfoMsg:
+      return LogLevel::INFO;
+    case QtWarningMsg:
+      return LogLevel::WARN;
+    case QtCriticalMsg:
+      return LogLevel::ERROR;
+    case QtFatalMsg:
+      return LogLevel::CRITICAL;
+    default:
+      return LogLevel::INFO;
+  }
+}
+}  // anonymous namespace
+
 void HertLog::enableQtLogRedirect()
 {
   if (s_qt_redirect_enabled.load()) {
@@ -379,6 +1060,7 @@ void HertLog::enableQtLogRedirect()
   }
 
   s_original_qt_handler = qInstallMessageHandler(qtMessageHandler);
+  s_original_qt_filter = QLoggingCategory::installFilter(qtCategoryFilter);
   s_qt_redirect_enabled.store(true);
 
   debug("Qt log redirection enabled");
@@ -390,12 +1072,42 @@ void HertLog::disableQtLogRedirect()
     return;
   }
 
-  qInstallMessageHandler(s_original_qt_handler);
   s_qt_redirect_enabled.store(false);
+  // 恢复原过滤器时Qt按原规则重新设置所有分类
+  QLoggingCategory::installFilter(s_original_qt_filter);
+  s_original_qt_filter = nullptr;
+  qInstallMessageHandler(s_original_qt_handler);
 
   debug("Qt log redirection disabled");
 }
 
+void HertLog::qtCategoryFilter(QLoggingCategory* category)
+{
+  // 先按Qt自己的规则(QT_LOGGING_RULES等)设置，再关闭Hert分类不输出的级别
+  if (s_original_qt_filter) {
+    s_original_qt_filter(category);
+  }
+  if (!s_initialized.load()) {
+    return;
+  }
+  const LogCategory& mapped = detail::qt_category(category->categoryName());
+  for (const QtMsgType type :
+       {QtDebugMsg, QtInfoMsg, QtWarningMsg, QtCriticalMsg})
+  {
+    if (category->isEnabled(type) && !mapped.is_enabled(qt_level(type))) {
+      category->setEnabled(type, false);
+    }
+  }
+}
+
+void HertLog::refresh_qt_categories()
+{
+  if (s_qt_redirect_enabled.load()) {
+    // 重新安装过滤器会对所有已注册的Qt分类再执行一次
+    QLoggingCategory::installFilter(qtCategoryFilter);
+  }
+}
+
 void HertLog::qtMessageHandler(QtMsgType type,
                                const QMessageLogContext& context,
                                const QString& msg)
@@ -408,44 +1120,35 @@ void HertLog::qtMessageHandler(QtMsgType type,
     return;
   }
 
-  LogLevel level = LogLevel::INFO;
-  switch (type) {
-    case QtDebugMsg:
-      level = LogLevel::DEBUG;
-      break;
-    case QtInfoMsg:
-      level = LogLevel::INFO;
-      break;
-    case QtWarningMsg:
-      level = LogLevel::WARN;
-      break;
-    case QtCriticalMsg:
-      level = LogLevel::ERROR;
-      break;
-    case QtFatalMsg:
-      level = LogLevel::CRITICAL;
-      break;
-    default:
-      level = LogLevel::INFO;
-      break;
+  // 分类级别关闭的消息在编码转换前返回，致命消息总是输出
+  const LogLevel level = qt_level(type);
+  const LogCategory& category = detail::qt_category(context.category);
+  if (type != QtFatalMsg && !category.is_enabled(level)) {
+    return;
   }
 
-  std::string location_info;
+  // UTF-16只转换一次，直接写入本线程复用的缓冲，位置信息追加在其后
+  thread_local fmt::memory_buffer text;
+  text.clear();
+  constexpr std::string_view kPrefix = "[Qt] ";
+  text.append(kPrefix.data(), kPrefix.data() + kPrefix.size());
+  detail::append_utf16(
+      text,
+      std::u16string_view(reinterpret_cast<const char16_t*>(msg.utf16()),
+                          static_cast<std::size_t>(msg.size())));
   if (context.file) {
-    location_info = fmt::format("{}:{}", context.file, context.line);
+    fmt::format_to(fmt::appender(text), " ({}:{}", context.file, context.line);
     if (context.function) {
-      location_info += fmt::format(" in {}", context.function);
+      fmt::format_to(fmt::appender(text), " in {}", context.function);
     }
+    text.push_back(')');
   }
 
-  std::string final_msg = msg.toStdString();
-  if (!location_info.empty()) {
-    final_msg = fmt::format("[Qt] {} ({})", final_msg, location_info);
-  } else {
-    final_msg = fmt::format("[Qt] {}", final_msg);
+  const std::string_view message(text.data(), text.size());
+  if (is_flight_recording()) {
+    HertLogFlightRecorder::record_text(level, category.name(), message);
   }
-
-  log_message_internal(level, final_msg);
+  log_message_enabled(level, message, category.name());
 
   // 对于QtFatalMsg，调用原始处理器确保程序终止
   if (type == QtFatalMsg && s_original_qt_handler) {
@@ -471,9 +1174,12 @@ void HertLog::enableStdRedirect()
   s_cout_redirect = std::make_unique<LogStreamBuf>(LogLevel::INFO);
   s_cerr_redirect = std::make_unique<LogStreamBuf>(LogLevel::ERROR);
 
-  // 重定向标准输出
+  // 重定向标准输出。cerr默认设有unitbuf，每次<<后都会sync，一行会被拆成
+  // 多条记录；重定向期间清除，由换行或显式刷新结束一行
   std::cout.rdbuf(s_cout_redirect.get());
   std::cerr.rdbuf(s_cerr_redirect.get());
+  s_original_cerr_unitbuf = std::cerr.flags() & std::ios_base::unitbuf;
+  std::cerr.unsetf(std::ios_base::unitbuf);
 
   s_std_redirect_enabled.store(true);
 
@@ -493,6 +1199,7 @@ void HertLog::disableStdRedirect()
   }
   if (s_original_cerr_buf) {
     std::cerr.rdbuf(s_original_cerr_buf);
+    std::cerr.setf(s_original_cerr_unitbuf);
     s_original_cerr_buf = nullptr;
   }
 
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+
+#include "HertLogArchiver.hpp"
+#include "HertLogDiagnostics.hpp"
+
+#include <fmt/format.h>
+#include <spdlog/details/file_helper.h>
+#include <zlib.h>
+
+#ifdef __linux__
+#  include <sys/resource.h>
+#endif
+
+namespace Hert
+{
+
+namespace
+{
+constexpr std::string_view kArchiveExtension = ".gz";
+constexpr std::size_t kChunkSize = 64UL * 1024UL;
+}  // anonymous namespace
+
+std::string detail::log_segment_path(const std::string& path,
+                                     std::uint64_t index)
+{
+  const auto [base, extension] =
+      spdlog::details::file_helper::split_by_extension(path);
+  return fmt::format("{}.{:06}{}", base, index, extension);
+}
+
+std::vector<std::pair<std::uint64_t, std::string>> detail::list_log_segments(
+    const std::string& path)
+{
+  const auto [base, extension] =
+      spdlog::details::file_helper::split_by_extension(path);
+  const std::filesystem::path base_path(base);
+  const std::string prefix = base_path.filename().string() + ".";
+  const auto directory = base_path.has_parent_path()
+      ? base_path.parent_path()
+      : std::filesystem::path(".");
+
+  std::vector<std::pair<std::uint64_t, std::string>> segments;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(directory, error))
+  {
+    const std::string filename = entry.path().filename().string();
+    std::string_view name = filename;
+    if (name.ends_with(kArchiveExtension)) {
+      name.remove_suffix(kArchiveExtension.size());
+    }
+    if (name.size() <= prefix.size() + extension.size()
+        || !name.starts_with(prefix) || !name.ends_with(extension))
+    {
+      continue;
+    }
+    const std::string digits(name.substr(
+        prefix.size(), name.size() - prefix.size() - extension.size()));
+    if (digits.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    segments.emplace_back(std::stoull(digits), entry.path().string());
+  }
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+HertLogArchiver::HertLogArchiver()
+{
+  m_thread = std::thread([this]() { run(); });
+}
+
+HertLogArchiver::~HertLogArchiver()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wakeup.notify_one();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void HertLogArchiver::submit(std::string file,
+                             std::string series_path,
+                             std::size_t max_files)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(Job {std::move(file), std::move(series_path), max_files});
+  }
+  m_wakeup.notify_one();
+}
+
+void HertLogArchiver::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this]() { return m_jobs.empty() && !m_busy; });
+}
+
+void HertLogArchiver::run()
+{
+#ifdef __linux__
+  // Linux上who为0时只调整当前线程的nice值
+  ::setpriority(PRIO_PROCESS, 0, 19);
+#endif
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_wakeup.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+    if (m_jobs.empty()) {
+      return;  // 退出前处理完所有已提交的文件
+    }
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    m_busy = true;
+    lock.unlock();
+
+    compress(job.file);
+    enforce_retention(job.series_path, job.max_files);
+
+    lock.lock();
+    m_busy = false;
+    if (m_jobs.empty()) {
+      m_idle.notify_all();
+    }
+  }
+}
+
+void HertLogArchiver::compress(const std::string& file)
+{
+  // 先写临时文件，中途失败或退出不会留下不完整的压缩包
+  const std::string target = file + std::string(kArchiveExtension);
+  const std::string temporary = target + ".tmp";
+
+  std::ifstream input(file, std::ios::binary);
+  gzFile output = input ? gzopen(temporary.c_str(), "wb6") : nullptr;
+  if (!output) {
+    detail::diagnostics() << "Failed to compress log file: " << file << '\n';
+    return;
+  }
+
+  std::array<char, kChunkSize> buffer {};
+  bool ok = true;
+  while (ok && input) {
+    input.read(buffer.data(), buffer.size());
+    const auto count = static_cast<unsigned>(input.gcount());
+    if (count > 0) {
+      ok = gzwrite(output, buffer.data(), count) == static_cast<int>(count);
+    }
+  }
+  ok = gzclose(output) == Z_OK && ok && input.eof();
+  input.close();
+
+  std::error_code error;
+  if (ok) {
+    std::filesystem::rename(temporary, target, error);
+    ok = !error;
+  }
+  if (!ok) {
+    detail::diagnostics() << "Failed to compress log file: " << file << '\n';
+    std::filesystem::remove(temporary, error);
+    return;
+  }
+  std::filesystem::remove(file, error);
+}
+
+void HertLogArchiver::enforce_retention(const std::string& series_path,
+                                        std::size_t max_files)
+{
+  // 只统计压缩包，未压缩的分段还在写入或排队压缩
+  std::vector<std::string> archives;
+  for (auto& [index, path] : detail::list_log_segments(series_path)) {
+    if (path.ends_with(kArchiveExtension)) {
+      archives.push_back(std::move(path));
+    }
+  }
+  std::error_code error;
+  for (std::size_t i = 0; i + max_files < archives.size(); ++i) {
+    std::filesystem::remove(archives[i], error);
+  }
+}
+
+}  // namespace Hert
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Hert
+{
+
+namespace detail
+{
+/**
+ * @brief 日志序列中第index个分段的文件名，如hert.log -> hert.000003.log
+ */
+std::string log_segment_path(const std::string& path, std::uint64_t index);
+
+/**
+ * @brief 列出磁盘上属于该日志序列的分段(含.gz压缩包)，按序号升序
+ */
+std::vector<std::pair<std::uint64_t, std::string>> list_log_segments(
+    const std::string& path);
+}  // namespace detail
+
+/**
+ * @brief 轮转文件的后台压缩器
+ *
+ * sink把轮转出的文件交给压缩器后立即返回，压缩在低优先级后台线程上
+ * 以gzip格式写到同名.gz文件，完成后删除原文件，再按max_files清理该
+ * 序列中最旧的分段。析构时处理完所有已提交的文件。
+ */
+class HertLogArchiver
+{
+public:
+  HertLogArchiver();
+  ~HertLogArchiver();
+
+  HertLogArchiver(const HertLogArchiver&) = delete;
+  HertLogArchiver& operator=(const HertLogArchiver&) = delete;
+  HertLogArchiver(HertLogArchiver&&) = delete;
+  HertLogArchiver& operator=(HertLogArchiver&&) = delete;
+
+  /**
+   * @brief 提交一个已轮转的文件
+   * @param file 待压缩的文件
+   * @param series_path 所属日志序列的配置路径
+   * @param max_files 序列保留的分段数
+   */
+  void submit(std::string file, std::string series_path, std::size_t max_files);
+
+  /**
+   * @brief 等待已提交的文件全部处理完
+   */
+  void wait_idle();
+
+private:
+  struct Job
+  {
+    std::string file;
+    std::string series_path;
+    std::size_t max_files;
+  };
+
+  void run();
+  static void compress(const std::string& file);
+  static void enforce_retention(const std::string& series_path,
+                                std::size_t max_files);
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_idle;
+  std::deque<Job> m_jobs;
+  bool m_busy = false;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+}  // namespace Hert
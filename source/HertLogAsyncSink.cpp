@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <utility>
+
+#include "HertLogAsyncSink.hpp"
+#include "HertLogDiagnostics.hpp"
+
+namespace Hert
+{
+
+namespace
+{
+// sync等待写入线程的最长时间，与后端flush一致
+constexpr auto kSyncTimeout = std::chrono::seconds(5);
+}  // anonymous namespace
+
+HertAsyncSink::HertAsyncSink(spdlog::sink_ptr target,
+                             std::size_t capacity,
+                             LogOverflowPolicy policy,
+                             std::chrono::milliseconds block_timeout)
+    : m_sink(std::move(target))
+    , m_capacity(std::max<std::size_t>(capacity, 1))
+    , m_policy(policy)
+    , m_block_timeout(block_timeout)
+{
+  set_level(m_sink->level());
+  m_worker = std::thread([this]() { run(); });
+}
+
+HertAsyncSink::~HertAsyncSink()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_not_empty.notify_one();
+  if (m_worker.joinable()) {
+    m_worker.join();  // 写入线程退出前写完队列中的记录
+  }
+}
+
+void HertAsyncSink::log(const spdlog::details::log_msg& msg)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_queue.size() >= m_capacity) {
+    const auto has_room = [this]()
+    { return m_queue.size() < m_capacity || m_stop; };
+    if (msg.level >= spdlog::level::err) {
+      m_not_full.wait(lock, has_room);
+    } else if (m_policy == LogOverflowPolicy::DROP_NEWEST) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else if (m_policy == LogOverflowPolicy::OVERWRITE_OLDEST) {
+      // 只覆盖最早的低于ERROR的记录，队列中全是ERROR及以上时丢弃新记录
+      const auto victim =
+          std::find_if(m_queue.begin(),
+                       m_queue.end(),
+                       [](const spdlog::details::log_msg_buffer& queued)
+                       { return queued.level < spdlog::level::err; });
+      if (victim == m_queue.end()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      m_queue.erase(victim);
+      ++m_done;
+      m_overwritten.fetch_add(1, std::memory_order_relaxed);
+    } else if (m_block_timeout.count() == 0) {
+      m_not_full.wait(lock, has_room);
+    } else if (!m_not_full.wait_for(lock, m_block_timeout, has_room)) {
+      m_timed_out.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  m_queue.emplace_back(msg);
+  ++m_pushed;
+  if (m_queue.size() == 1) {
+    m_not_empty.notify_one();
+  }
+}
+
+void HertAsyncSink::flush()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_flush_requested = true;
+  }
+  m_not_empty.notify_one();
+}
+
+void HertAsyncSink::set_pattern(const std::string& pattern)
+{
+  m_sink->set_pattern(pattern);
+}
+
+void HertAsyncSink::set_formatter(std::unique_ptr<spdlog::formatter> formatter)
+{
+  m_sink->set_formatter(std::move(formatter));
+}
+
+bool HertAsyncSink::sync()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const std::uint64_t target = m_pushed;
+  m_flush_requested = true;
+  m_not_empty.notify_one();
+  return m_flushed_cv.wait_for(
+      lock, kSyncTimeout, [this, target]() { return m_flushed >= target; });
+}
+
+bool HertAsyncSink::sync_all(const std::vector<spdlog::sink_ptr>& sinks)
+{
+  bool complete = true;
+  for (const auto& sink : sinks) {
+    if (auto* async = dynamic_cast<HertAsyncSink*>(sink.get())) {
+      complete = async->sync() && complete;
+    }
+  }
+  return complete;
+}
+
+void HertAsyncSink::add_drops(LogDropStats& stats,
+                              const std::vector<spdlog::sink_ptr>& sinks)
+{
+  for (const auto& sink : sinks) {
+    if (const auto* async = dynamic_cast<const HertAsyncSink*>(sink.get())) {
+      stats.dropped += async->m_dropped.load(std::memory_order_relaxed);
+      stats.overwritten += async->m_overwritten.load(std::memory_order_relaxed);
+      stats.timed_out += async->m_timed_out.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void HertAsyncSink::run()
+{
+  std::deque<spdlog::details::log_msg_buffer> batch;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_not_empty.wait(lock,
+                     [this]()
+                     { return m_stop || m_flush_requested || !m_queue.empty(); });
+    if (m_queue.empty() && !m_flush_requested && m_stop) {
+      return;
+    }
+
+    // 整批取出后释放锁，写入期间生产者不受影响
+    batch.swap(m_queue);
+    const bool flush_requested = std::exchange(m_flush_requested, false);
+    const std::size_t count = batch.size();
+    lock.unlock();
+    m_not_full.notify_all();
+
+    for (const auto& msg : batch) {
+      try {
+        m_sink->log(msg);
+      } catch (const std::exception& e) {
+        detail::diagnostics() << "Exception in log sink: " << e.what() << '\n';
+      }
+    }
+    batch.clear();
+    // 同一批次内的多次刷新请求合并为一次
+    if (flush_requested) {
+      try {
+        m_sink->flush();
+      } catch (const std::exception& e) {
+        detail::diagnostics() << "Exception in log sink: " << e.what() << '\n';
+      }
+    }
+
+    lock.lock();
+    m_done += count;
+    if (flush_requested) {
+      m_flushed = m_done;
+      m_flushed_cv.notify_all();
+    }
+  }
+}
+
+}  // namespace Hert
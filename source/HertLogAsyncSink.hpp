@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+namespace Hert
+{
+
+/**
+ * @brief 以独立队列和写入线程隔离单个sink的包装
+ *
+ * 后端线程把记录拷贝进各包装的队列后立即返回，由各自的线程写入实际的
+ * sink。慢的终端只积压自己的队列，队列满时按自己的溢出策略等待或丢弃，
+ * 不会拖住文件等其他输出。ERROR及以上级别的记录不按策略丢弃，满时等待；
+ * 覆盖策略也只覆盖低于ERROR的记录。
+ */
+class HertAsyncSink final : public spdlog::sinks::sink
+{
+public:
+  /**
+   * @param target 实际输出的sink，级别与格式仍由它自己控制
+   * @param capacity 队列容量(消息条数)
+   * @param policy 队列已满时的处理方式
+   * @param block_timeout BLOCK策略的最长等待，为零时一直等待
+   */
+  HertAsyncSink(spdlog::sink_ptr target,
+                std::size_t capacity,
+                LogOverflowPolicy policy,
+                std::chrono::milliseconds block_timeout);
+  ~HertAsyncSink() override;
+
+  HertAsyncSink(const HertAsyncSink&) = delete;
+  HertAsyncSink& operator=(const HertAsyncSink&) = delete;
+  HertAsyncSink(HertAsyncSink&&) = delete;
+  HertAsyncSink& operator=(HertAsyncSink&&) = delete;
+
+  void log(const spdlog::details::log_msg& msg) override;
+
+  /**
+   * @brief 请求写入线程刷新，不等待，供出错时自动刷新使用
+   */
+  void flush() override;
+
+  void set_pattern(const std::string& pattern) override;
+  void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+  /**
+   * @brief 等待此前入队的记录全部写出并刷新实际的sink
+   * @return 写入线程5秒内没有完成时返回false
+   */
+  bool sync();
+
+  /**
+   * @brief 对列表中的每个包装调用sync
+   * @return 所有包装都完成时返回true
+   */
+  static bool sync_all(const std::vector<spdlog::sink_ptr>& sinks);
+
+  /**
+   * @brief 把列表中各包装的丢弃计数累加到stats
+   */
+  static void add_drops(LogDropStats& stats,
+                        const std::vector<spdlog::sink_ptr>& sinks);
+
+private:
+  void run();
+
+  spdlog::sink_ptr m_sink;
+  const std::size_t m_capacity;
+  const LogOverflowPolicy m_policy;
+  const std::chrono::milliseconds m_block_timeout;
+
+  std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+  std::condition_variable m_flushed_cv;
+  std::deque<spdlog::details::log_msg_buffer> m_queue;
+  std::uint64_t m_pushed = 0;  // 入队的记录数
+  std::uint64_t m_done = 0;  // 已写出或被覆盖的记录数
+  std::uint64_t m_flushed = 0;  // 最近一次刷新时的m_done
+  bool m_flush_requested = false;
+  bool m_stop = false;
+
+  std::atomic<std::uint64_t> m_dropped {0};
+  std::atomic<std::uint64_t> m_overwritten {0};
+  std::atomic<std::uint64_t> m_timed_out {0};
+
+  std::thread m_worker;
+};
+
+}  // namespace Hert
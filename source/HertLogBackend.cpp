@@ -0,0 +1,890 @@
+#include <algorithm>
+#include <chrono>
+
+#include "HertLogBackend.hpp"
+
+#include "HertLogAsyncSink.hpp"
+#include "HertLogDiagnostics.hpp"
+
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+
+namespace Hert
+{
+
+namespace
+{
+std::size_t round_up_pow2(std::size_t value)
+{
+  std::size_t result = 1;
+  while (result < value) {
+    result <<= 1U;
+  }
+  return result;
+}
+
+// 标记当前线程是否为后端线程
+thread_local bool t_is_backend_thread = false;
+// 标记当前线程入队时从不等待，如fd捕获的读取线程
+thread_local bool t_never_blocks = false;
+
+void set_site(LogRecordHeader& header, const LogSite* site)
+{
+  // 调用点可能是栈上的临时对象，只拷贝其中的静态字符串指针
+  if (site) {
+    header.file = site->file;
+    header.basename = site->basename;
+    header.line = site->line;
+  }
+}
+}  // anonymous namespace
+
+// ============ LogRingBuffer ============
+
+LogRingBuffer::LogRingBuffer(std::size_t capacity)
+    : m_storage(round_up_pow2(std::max<std::size_t>(capacity, 4096)))
+    , m_mask(m_storage.size() - 1)
+{
+}
+
+std::byte* LogRingBuffer::prepare(std::size_t size)
+{
+  const std::uint64_t write_pos = m_write_pos.load(std::memory_order_relaxed);
+  const std::size_t offset = static_cast<std::size_t>(write_pos) & m_mask;
+  const std::size_t tail = m_storage.size() - offset;
+  const std::size_t needed = size <= tail ? size : tail + size;
+
+  // 先用缓存的读位置判断，空间不足时才读取消费者的原子变量
+  if (write_pos + needed - m_cached_read_pos > m_storage.size()) {
+    m_cached_read_pos = m_read_pos.load(std::memory_order_acquire);
+    if (write_pos + needed - m_cached_read_pos > m_storage.size()) {
+      return nullptr;
+    }
+  }
+
+  if (size <= tail) {
+    return m_storage.data() + offset;
+  }
+
+  // 尾部放不下，填充到末尾后从头开始
+  LogRecordHeader padding {};
+  padding.size = static_cast<std::uint32_t>(tail);
+  padding.kind = LogRecordKind::PADDING;
+  // 尾部至少8字节，只写入size与kind
+  std::memcpy(m_storage.data() + offset, &padding, sizeof(std::uint64_t));
+  m_write_pos.store(write_pos + tail, std::memory_order_release);
+  return m_storage.data();
+}
+
+const LogRecordHeader* LogRingBuffer::front() const
+{
+  const std::uint64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+  if (read_pos == m_write_pos.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return reinterpret_cast<const LogRecordHeader*>(
+      m_storage.data() + (static_cast<std::size_t>(read_pos) & m_mask));
+}
+
+// ============ HertLogBackend ============
+
+namespace
+{
+std::atomic<std::uint64_t> g_backend_generation {0};
+
+// 线程局部的队列句柄，线程退出时标记队列待回收
+struct ThreadQueueSlot
+{
+  std::uint64_t generation = 0;
+  std::shared_ptr<LogThreadQueue> queue;
+
+  ThreadQueueSlot() = default;
+  ThreadQueueSlot(const ThreadQueueSlot&) = delete;
+  ThreadQueueSlot& operator=(const ThreadQueueSlot&) = delete;
+  ThreadQueueSlot(ThreadQueueSlot&&) = delete;
+  ThreadQueueSlot& operator=(ThreadQueueSlot&&) = delete;
+
+  ~ThreadQueueSlot()
+  {
+    if (queue) {
+      queue->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+thread_local ThreadQueueSlot t_queue_slot;
+
+// 后台线程无事可做时的最长休眠时间，兜底错过的唤醒
+constexpr auto kIdleWait = std::chrono::milliseconds(10);
+
+// ERROR通道的容量下限，保证较长的错误消息不被截断
+constexpr std::size_t kMinUrgentBytes = 64 * 1024;
+
+// 持续繁忙时每处理这么多条记录检查一次队列压力与丢弃统计
+constexpr std::uint64_t kHousekeepingRecords = 64;
+
+// 降载至少持续这么久才恢复，避免在阈值附近反复切换
+constexpr auto kMinShedTime = std::chrono::milliseconds(500);
+
+void add_drops(LogDropStats& stats, const LogThreadQueue& queue)
+{
+  stats.dropped += queue.dropped.load(std::memory_order_relaxed);
+  stats.overwritten += queue.overwritten.load(std::memory_order_relaxed);
+  stats.timed_out += queue.timed_out.load(std::memory_order_relaxed);
+}
+
+// 队首记录，跳过回绕填充
+const LogRecordHeader* front_record(LogRingBuffer& ring)
+{
+  const LogRecordHeader* header = ring.front();
+  while (header != nullptr && header->kind == LogRecordKind::PADDING) {
+    ring.pop(header->size);
+    header = ring.front();
+  }
+  return header;
+}
+
+// 在discard_mutex内重新读取ring的队首并缓存
+void cache_ring_head(LogThreadQueue& queue)
+{
+  const LogRecordHeader* header = front_record(queue.ring);
+  queue.cached_head = header != nullptr;
+  if (header != nullptr) {
+    queue.cached_head_pos = queue.ring.read_pos();
+    queue.cached_head_time = header->time_ns;
+  }
+}
+}  // anonymous namespace
+
+HertLogBackend::HertLogBackend(
+    std::shared_ptr<spdlog::logger> logger,
+    std::size_t queue_bytes,
+    LogOverflowPolicy overflow_policy,
+    std::chrono::milliseconds block_timeout,
+    std::chrono::milliseconds report_interval,
+    const LogShedConfig& shed,
+    const LogFlushConfig& flush,
+    LogClockSource clock_source,
+    std::unique_ptr<HertLogBinaryWriter> binary_writer,
+    std::unique_ptr<HertLogJsonWriter> json_writer)
+    : m_logger(std::move(logger))
+    , m_binary_writer(std::move(binary_writer))
+    , m_json_writer(std::move(json_writer))
+    , m_queue_bytes(queue_bytes)
+    , m_overflow_policy(overflow_policy)
+    , m_block_timeout(block_timeout)
+    , m_report_interval(report_interval)
+    , m_shed(shed)
+    , m_flush(flush)
+    , m_generation(g_backend_generation.fetch_add(1) + 1)
+    , m_clock(clock_source)
+    , m_next_report(std::chrono::steady_clock::now() + report_interval)
+    , m_flush_due(flush.interval.count() > 0
+                      ? std::chrono::steady_clock::now() + flush.interval
+                      : std::chrono::steady_clock::time_point::max())
+{
+  m_thread = std::thread([this]() { run(); });
+}
+
+HertLogBackend::~HertLogBackend()
+{
+  m_stop.store(true);
+  wake_consumer();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (t_queue_slot.generation == m_generation) {
+    t_queue_slot.queue.reset();
+  }
+}
+
+void HertLogBackend::push_formatted(LogLevel level,
+                                    const char* category,
+                                    const LogSite* site,
+                                    const char* function,
+                                    std::string_view message)
+{
+  LogRecordHeader header {};
+  header.kind = LogRecordKind::FORMATTED;
+  header.level = level;
+  header.category = category;
+  set_site(header, site);
+  header.function = function;
+  header.time_ns = m_clock.now();
+  header.thread_id = spdlog::details::os::thread_id();
+
+  // 超长消息截断，保证单条记录总能放进队列
+  const std::size_t max_payload =
+      local_queue().lane(level).max_record_size() - sizeof(header);
+  if (message.size() > max_payload) {
+    message = message.substr(0, max_payload);
+  }
+  push(header, reinterpret_cast<const std::byte*>(message.data()),
+       message.size());
+}
+bool HertLogBackend::push_deferred(LogLevel level,
+                                   const LogSite* site,
+                                   const char* function,
+                                   const char* category,
+                                   const detail::DeferredCodec* codec,
+                                   fmt::string_view format,
+                                   const std::byte* args,
+                                   std::size_t args_size)
+{
+  LogRecordHeader header {};
+  header.kind = LogRecordKind::DEFERRED;
+  header.level = level;
+  header.category = category;
+  set_site(header, site);
+  header.function = function;
+  header.codec = codec;
+  header.format_data = format.data();
+  header.format_size = format.size();
+  header.time_ns = m_clock.now();
+  header.thread_id = spdlog::details::os::thread_id();
+  return push(header, args, args_size);
+}
+
+bool HertLogBackend::push(const LogRecordHeader& header,
+                          const std::byte* payload,
+                          std::size_t payload_size)
+{
+  LogThreadQueue& queue = local_queue();
+  LogRingBuffer& ring = queue.lane(header.level);
+  const std::size_t size =
+      LogRingBuffer::aligned_size(sizeof(header) + payload_size);
+  if (size > ring.max_record_size()) {
+    return false;
+  }
+
+  std::byte* slot = ring.prepare(size);
+  if (slot == nullptr) {
+    slot = make_room(queue, ring, size);
+    if (slot == nullptr) {
+      return true;  // 按溢出策略丢弃，已计数
+    }
+  }
+
+  auto* stored = reinterpret_cast<LogRecordHeader*>(slot);
+  std::memcpy(stored, &header, sizeof(header));
+  stored->size = static_cast<std::uint32_t>(size);
+  stored->payload_size = static_cast<std::uint32_t>(payload_size);
+  if (payload_size > 0) {
+    std::memcpy(slot + sizeof(header), payload, payload_size);
+  }
+  ring.commit(size);
+
+  // 与后台线程的休眠检查之间没有全序保证，偶尔错过的唤醒由kIdleWait兜底
+  if (m_sleeping.load(std::memory_order_relaxed)) {
+    wake_consumer();
+  }
+  return true;
+}
+
+std::byte* HertLogBackend::make_room(LogThreadQueue& queue,
+                                     LogRingBuffer& ring,
+                                     std::size_t size)
+{
+  const bool urgent = &ring == &queue.urgent;
+  if (on_backend_thread() || t_never_blocks) {
+    // 处理器内部产生的日志，队列已满时丢弃以免自锁；不能等待的线程
+    // 也在这里丢弃，ERROR通道同样如此
+    queue.dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  if (!urgent && m_overflow_policy == LogOverflowPolicy::DROP_NEWEST) {
+    queue.dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  if (!urgent && m_overflow_policy == LogOverflowPolicy::OVERWRITE_OLDEST) {
+    // 后端只在锁内拷出队首记录，不会读到正被丢弃的数据
+    std::lock_guard<std::mutex> lock(queue.discard_mutex);
+    std::byte* slot = nullptr;
+    while ((slot = ring.prepare(size)) == nullptr) {
+      const LogRecordHeader* oldest = ring.front();
+      if (oldest == nullptr) {
+        break;
+      }
+      if (oldest->kind != LogRecordKind::PADDING) {
+        queue.overwritten.fetch_add(1, std::memory_order_relaxed);
+      }
+      ring.pop(oldest->size);
+    }
+    return slot;
+  }
+
+  // 休眠等待后台线程腾出空间，ERROR通道不设时限。先登记再检查空间，
+  // 与后台线程出队后检查等待者配对，两侧之间不会错过通知
+  const bool limited = !urgent && m_block_timeout.count() > 0;
+  const auto deadline = std::chrono::steady_clock::now() + m_block_timeout;
+  m_space_waiters.fetch_add(1);
+  std::byte* slot = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(m_wait_mutex);
+    while ((slot = ring.prepare(size)) == nullptr) {
+      m_wakeup.notify_one();  // 后台线程可能正在休眠
+      if (!limited) {
+        m_space_freed.wait(lock);
+        continue;
+      }
+      if (m_space_freed.wait_until(lock, deadline) == std::cv_status::timeout)
+      {
+        slot = ring.prepare(size);
+        if (slot == nullptr) {
+          queue.timed_out.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+      }
+    }
+  }
+  m_space_waiters.fetch_sub(1);
+  return slot;
+}
+
+LogThreadQueue& HertLogBackend::local_queue()
+{
+  if (t_queue_slot.generation != m_generation) {
+    if (t_queue_slot.queue) {
+      t_queue_slot.queue->retired.store(true, std::memory_order_release);
+    }
+    auto queue = std::make_shared<LogThreadQueue>(
+        m_queue_bytes, std::max(m_queue_bytes / 8, kMinUrgentBytes));
+    {
+      std::lock_guard<std::mutex> lock(m_queues_mutex);
+      m_queues.push_back(queue);
+      m_queues_version.fetch_add(1, std::memory_order_release);
+    }
+    t_queue_slot.queue = std::move(queue);
+    t_queue_slot.generation = m_generation;
+  }
+  return *t_queue_slot.queue;
+}
+
+bool HertLogBackend::flush()
+{
+  bool complete = true;
+  if (!on_backend_thread()) {
+    // 记录各队列当前的写位置，等待后台线程读到这里
+    struct Target
+    {
+      std::shared_ptr<LogThreadQueue> queue;
+      std::uint64_t ring;
+      std::uint64_t urgent;
+    };
+    std::vector<Target> targets;
+    {
+      std::lock_guard<std::mutex> lock(m_queues_mutex);
+      targets.reserve(m_queues.size());
+      for (const auto& queue : m_queues) {
+        targets.push_back(Target {
+            queue, queue->ring.write_pos(), queue->urgent.write_pos()});
+      }
+    }
+
+    m_flush_waiters.fetch_add(1);
+    std::unique_lock<std::mutex> lock(m_wait_mutex);
+    m_wakeup.notify_one();
+    complete = m_drained.wait_for(
+        lock,
+        std::chrono::seconds(5),
+        [&]()
+        {
+          for (const auto& target : targets) {
+            if (target.queue->ring.read_pos() < target.ring
+                || target.queue->urgent.read_pos() < target.urgent)
+            {
+              return false;
+            }
+          }
+          // 读到出队位置之后再检查，出队的记录须已写出
+          return !m_copied_pending.load();
+        });
+    m_flush_waiters.fetch_sub(1);
+  }
+  m_logger->flush();
+  if (m_binary_writer) {
+    m_binary_writer->flush();
+  }
+  if (m_json_writer) {
+    m_json_writer->flush();
+  }
+  return complete;
+}
+
+LogDropStats HertLogBackend::drop_stats()
+{
+  std::lock_guard<std::mutex> lock(m_queues_mutex);
+  LogDropStats stats = m_retired_drops;
+  for (const auto& queue : m_queues) {
+    add_drops(stats, *queue);
+  }
+  HertAsyncSink::add_drops(stats, m_logger->sinks());
+  return stats;
+}
+
+void HertLogBackend::housekeeping(
+    const std::vector<std::shared_ptr<LogThreadQueue>>& queues)
+{
+  if (m_stop.load()) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  flush_if_due(now);
+  m_clock.calibrate_if_due(now);
+  report_drops();
+  if (m_shed.enabled()) {
+    update_shedding(queues);
+  }
+}
+
+void HertLogBackend::update_shedding(
+    const std::vector<std::shared_ptr<LogThreadQueue>>& queues)
+{
+  // 只看普通通道：ERROR通道不受降载影响。延迟取各队首中最早一条已等待
+  // 的时长，空闲之后新入队的记录不会把空闲时间算作积压
+  double occupancy = 0;
+  bool pending = false;
+  std::int64_t oldest_time = 0;
+  for (const auto& queue : queues) {
+    const std::uint64_t used =
+        queue->ring.write_pos() - queue->ring.read_pos();
+    occupancy = std::max(occupancy,
+                         static_cast<double>(used)
+                             / static_cast<double>(queue->ring.capacity()));
+    std::int64_t time = 0;
+    if (used > 0 && ring_head_time(*queue, time)
+        && (!pending || time < oldest_time))
+    {
+      pending = true;
+      oldest_time = time;
+    }
+  }
+  const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::nanoseconds(
+          pending ? m_clock.to_ns(m_clock.now()) - m_clock.to_ns(oldest_time)
+                  : 0));
+
+  const bool by_occupancy = m_shed.high_ratio > 0;
+  const bool by_latency = m_shed.latency.count() > 0;
+  const auto now = std::chrono::steady_clock::now();
+  if (!m_shedding) {
+    if ((by_occupancy && occupancy >= m_shed.high_ratio)
+        || (by_latency && latency >= m_shed.latency))
+    {
+      // 先输出标记再提升级别，标记本身不会被过滤
+      HertLog::warn(
+          "Log load shedding on: queue {:.0f}% full, {} ms behind; "
+          "records below {} are discarded",
+          occupancy * 100,
+          latency.count(),
+          spdlog::level::to_string_view(
+              HertLog::convert_log_level(m_shed.level)));
+      HertLog::set_shed_level(m_shed.level);
+      m_shedding = true;
+      m_shed_since = now;
+    }
+    return;
+  }
+
+  // 低水位：占用低于low，延迟低于阈值的一半
+  if (now - m_shed_since < kMinShedTime
+      || (by_occupancy && occupancy >= m_shed.low_ratio)
+      || (by_latency && latency * 2 >= m_shed.latency))
+  {
+    return;
+  }
+  HertLog::set_shed_level(LogLevel::TRACE);
+  m_shedding = false;
+  HertLog::warn("Log load shedding off: queue {:.0f}% full, {} ms behind",
+                occupancy * 100,
+                latency.count());
+}
+
+void HertLogBackend::report_drops()
+{
+  if (m_report_interval.count() == 0) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (now < m_next_report) {
+    return;
+  }
+  m_next_report = now + m_report_interval;
+
+  const LogDropStats stats = drop_stats();
+  if (stats.total() == m_reported_drops.total()) {
+    return;
+  }
+  // 经由本线程的队列输出，与普通记录一样进入所有sink与处理器
+  HertLog::warn(
+      "{} log records lost to queue overflow in the last {} ms "
+      "(dropped: {}, overwritten: {}, timed out: {})",
+      stats.total() - m_reported_drops.total(),
+      m_report_interval.count(),
+      stats.dropped - m_reported_drops.dropped,
+      stats.overwritten - m_reported_drops.overwritten,
+      stats.timed_out - m_reported_drops.timed_out);
+  m_reported_drops = stats;
+}
+
+void HertLogBackend::run()
+{
+  t_is_backend_thread = true;
+  std::vector<std::shared_ptr<LogThreadQueue>> queues;
+  std::uint64_t queues_version = 0;
+  std::uint64_t processed = 0;
+
+  while (true) {
+    // 有新线程注册或线程退出后刷新本地的队列列表
+    if (queues_version != m_queues_version.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(m_queues_mutex);
+      queues = m_queues;
+      queues_version = m_queues_version.load(std::memory_order_relaxed);
+    }
+
+    if (drain_one(queues)) {
+      notify_space();
+      if (++processed % kHousekeepingRecords == 0) {
+        housekeeping(queues);
+      }
+      if (m_flush_waiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(m_wait_mutex);
+        m_drained.notify_all();
+      }
+      continue;
+    }
+
+    // 回收已退出线程的空队列
+    const auto retired = [](const std::shared_ptr<LogThreadQueue>& queue)
+    {
+      return queue->retired.load(std::memory_order_acquire)
+          && queue->ring.empty() && queue->urgent.empty();
+    };
+    if (std::any_of(queues.begin(), queues.end(), retired)) {
+      std::lock_guard<std::mutex> lock(m_queues_mutex);
+      for (const auto& queue : m_queues) {
+        if (retired(queue)) {
+          add_drops(m_retired_drops, *queue);
+        }
+      }
+      m_queues.erase(std::remove_if(m_queues.begin(), m_queues.end(), retired),
+                     m_queues.end());
+      m_queues_version.fetch_add(1, std::memory_order_release);
+      continue;
+    }
+
+    notify_space();  // 可能只弹出了回绕填充
+    std::unique_lock<std::mutex> lock(m_wait_mutex);
+    if (m_flush_waiters.load() > 0) {
+      m_drained.notify_all();
+    }
+    if (m_stop.load()) {
+      break;  // 已停止且队列排空
+    }
+    lock.unlock();
+    housekeeping(queues);  // 产生的记录在下一轮处理
+    lock.lock();
+
+    // 休眠前再检查一次，避免与生产者的唤醒错过
+    m_sleeping.store(true);
+    const bool has_data = std::any_of(
+        queues.begin(),
+        queues.end(),
+        [](const auto& queue)
+        { return !queue->ring.empty() || !queue->urgent.empty(); });
+    if (!has_data
+        && queues_version == m_queues_version.load(std::memory_order_acquire))
+    {
+      // 有待定的刷新时按时醒来
+      const auto now = std::chrono::steady_clock::now();
+      m_wakeup.wait_for(
+          lock,
+          m_flush_due - now < kIdleWait
+              ? std::chrono::duration_cast<std::chrono::milliseconds>(
+                    m_flush_due - now)
+              : kIdleWait);
+    }
+    m_sleeping.store(false);
+  }
+}
+
+bool HertLogBackend::drain_one(
+    std::vector<std::shared_ptr<LogThreadQueue>>& queues)
+{
+  // 在各队列队首中挑出时间戳最早的一条，保证跨线程输出有序
+  const bool overwrite =
+      m_overflow_policy == LogOverflowPolicy::OVERWRITE_OLDEST;
+  LogThreadQueue* earliest = nullptr;
+  LogRingBuffer* earliest_ring = nullptr;
+  std::int64_t earliest_time = 0;
+  const auto consider = [&](LogThreadQueue& queue,
+                            LogRingBuffer& ring,
+                            std::int64_t time)
+  {
+    if (earliest == nullptr || time < earliest_time) {
+      earliest = &queue;
+      earliest_ring = &ring;
+      earliest_time = time;
+    }
+  };
+  for (const auto& queue : queues) {
+    if (const LogRecordHeader* header = front_record(queue->urgent)) {
+      consider(*queue, queue->urgent, header->time_ns);
+    }
+    std::int64_t time = 0;
+    if (ring_head_time(*queue, time)) {
+      consider(*queue, queue->ring, time);
+    }
+  }
+
+  if (earliest == nullptr) {
+    return false;
+  }
+
+  if (!overwrite || earliest_ring == &earliest->urgent) {
+    LogRecordHeader* header = earliest_ring->front();
+    process(*header);
+    request_flush(header->level, header->size);
+    earliest_ring->pop(header->size);
+    return true;
+  }
+
+  // 生产者可能随时丢弃队首，拷出后释放锁再处理，写入阻塞时不拖住生产者。
+  // 挑选之后队首若已被丢弃，直接处理新的队首
+  {
+    std::lock_guard<std::mutex> lock(earliest->discard_mutex);
+    const LogRecordHeader* header = front_record(*earliest_ring);
+    if (header == nullptr) {
+      return true;
+    }
+    m_scratch.resize(header->size / sizeof(std::uint64_t));
+    std::memcpy(m_scratch.data(), header, header->size);
+    // 先出队后写出，flush的等待者据此不把这条记录当作已写出
+    m_copied_pending.store(true);
+    earliest_ring->pop(header->size);
+    cache_ring_head(*earliest);  // 趁持有锁缓存新的队首
+  }
+  auto* header = reinterpret_cast<LogRecordHeader*>(m_scratch.data());
+  process(*header);
+  m_copied_pending.store(false);
+  request_flush(header->level, header->size);
+  return true;
+}
+
+bool HertLogBackend::ring_head_time(LogThreadQueue& queue, std::int64_t& time)
+{
+  if (m_overflow_policy != LogOverflowPolicy::OVERWRITE_OLDEST) {
+    const LogRecordHeader* header = front_record(queue.ring);
+    if (header == nullptr) {
+      return false;
+    }
+    time = header->time_ns;
+    return true;
+  }
+
+  // 生产者丢弃队首时会推进读位置，读位置仍是缓存时的值说明队首未变，
+  // 只有变化后才对这一个队列加锁重新读取
+  const std::uint64_t read_pos = queue.ring.read_pos();
+  if (!queue.cached_head || queue.cached_head_pos != read_pos) {
+    if (read_pos == queue.ring.write_pos()) {
+      queue.cached_head = false;
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(queue.discard_mutex);
+    cache_ring_head(queue);
+    if (!queue.cached_head) {
+      return false;
+    }
+  }
+  time = queue.cached_head_time;
+  return true;
+}
+
+void HertLogBackend::request_flush(LogLevel level, std::size_t bytes)
+{
+  m_unflushed_bytes += bytes;
+  if (level >= m_flush.level) {
+    if (m_flush.latency.count() == 0) {
+      flush_outputs();
+      return;
+    }
+    // 只提前不推后：窗口内后续的记录合并进已定的这次刷新
+    m_flush_due = std::min(m_flush_due,
+                           std::chrono::steady_clock::now() + m_flush.latency);
+  }
+  if (m_flush.bytes > 0 && m_unflushed_bytes >= m_flush.bytes) {
+    flush_outputs();
+  }
+}
+
+void HertLogBackend::flush_if_due(std::chrono::steady_clock::time_point now)
+{
+  if (now < m_flush_due) {
+    return;
+  }
+  if (m_unflushed_bytes > 0) {
+    flush_outputs();
+    return;
+  }
+  m_flush_due = m_flush.interval.count() > 0
+      ? now + m_flush.interval
+      : std::chrono::steady_clock::time_point::max();
+}
+
+void HertLogBackend::flush_outputs()
+{
+  m_logger->flush();
+  if (m_binary_writer) {
+    m_binary_writer->flush();
+  }
+  if (m_json_writer) {
+    m_json_writer->flush();
+  }
+  m_unflushed_bytes = 0;
+  m_flush_due = m_flush.interval.count() > 0
+      ? std::chrono::steady_clock::now() + m_flush.interval
+      : std::chrono::steady_clock::time_point::max();
+}
+
+void HertLogBackend::wake_consumer()
+{
+  std::lock_guard<std::mutex> lock(m_wait_mutex);
+  m_wakeup.notify_one();
+}
+
+void HertLogBackend::notify_space()
+{
+  // 出队与读取等待者之间不能重排，否则可能错过刚登记的生产者
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_space_waiters.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(m_wait_mutex);
+    m_space_freed.notify_all();
+  }
+}
+
+void HertLogBackend::process(LogRecordHeader& header)
+{
+  // 记录已归后台线程所有，原地换算时间戳，各输出都直接读取纳秒数
+  header.time_ns = m_clock.to_wall_ns(header.time_ns);
+
+  const auto* payload = reinterpret_cast<const std::byte*>(&header + 1);
+  LogLevel level = header.level;
+
+  // 二进制输出直接转写参数，不需要文本
+  if (m_binary_writer && level >= m_binary_writer->level()) {
+    m_binary_writer->write(header);
+  }
+
+  const auto spd_level = HertLog::convert_log_level(level);
+  const bool to_json = m_json_writer && level >= m_json_writer->level();
+  const bool needs_text =
+      (HertLog::s_handlers_on_backend.load(std::memory_order_relaxed)
+       && HertLog::has_custom_handlers(level))
+      || std::any_of(m_logger->sinks().begin(),
+                     m_logger->sinks().end(),
+                     [spd_level](const spdlog::sink_ptr& sink)
+                     { return sink->should_log(spd_level); });
+  if (!needs_text) {
+    // 结构化记录的JSON直接由参数区编码，不需要先生成文本
+    if (to_json && header.kind == LogRecordKind::DEFERRED
+        && header.codec->json != nullptr)
+    {
+      m_json_writer->write(header, level, {}, true);
+      return;
+    }
+    if (!to_json) {
+      return;
+    }
+  }
+
+  // 位置前缀与消息写入同一缓冲区，处理器只取消息部分
+  fmt::memory_buffer buffer;
+  const bool has_location =
+      header.file != nullptr && header.line > 0 && header.function != nullptr;
+  if (has_location) {
+    detail::append_location(buffer,
+                            header.category,
+                            header.basename,
+                            header.line,
+                            header.function);
+  }
+  const std::size_t prefix_size = buffer.size();
+
+  bool structured = false;
+  if (header.kind == LogRecordKind::DEFERRED) {
+    structured = header.codec->json != nullptr;
+    try {
+      header.codec->format(
+          fmt::string_view(header.format_data, header.format_size),
+          payload,
+          buffer);
+    } catch (const std::exception& e) {
+      buffer.resize(prefix_size);
+      fmt::format_to(fmt::appender(buffer), "Log format error: {}", e.what());
+      level = LogLevel::ERROR;
+      structured = false;
+    }
+  } else {
+    const auto* text = reinterpret_cast<const char*>(payload);
+    buffer.append(text, text + header.payload_size);
+  }
+
+  const std::string_view line(buffer.data(), buffer.size());
+  const std::string_view message = line.substr(prefix_size);
+
+  if (to_json) {
+    m_json_writer->write(header, level, message, structured);
+  }
+
+  const spdlog::source_loc source = has_location
+      ? spdlog::source_loc {header.file, header.line, header.function}
+      : spdlog::source_loc {};
+  spdlog::details::log_msg msg(source,
+                               m_logger->name(),
+                               HertLog::convert_log_level(level),
+                               spdlog::string_view_t(line.data(), line.size()));
+  msg.time = spdlog::log_clock::time_point(
+      std::chrono::duration_cast<spdlog::log_clock::duration>(
+          std::chrono::nanoseconds(header.time_ns)));
+  msg.thread_id = header.thread_id;
+
+  for (const auto& sink : m_logger->sinks()) {
+    if (!sink->should_log(msg.level)) {
+      continue;
+    }
+    try {
+      sink->log(msg);
+    } catch (const std::exception& e) {
+      detail::diagnostics() << "Exception in log sink: " << e.what() << '\n';
+    }
+  }
+
+  if (!HertLog::s_handlers_on_backend.load(std::memory_order_relaxed)
+      || !HertLog::has_custom_handlers(level))
+  {
+    return;
+  }
+  HertLog::call_custom_handlers(
+      LogRecord {level,
+                 message,
+                 header.category ? header.category : "",
+                 has_location ? header.file : "",
+                 has_location ? header.line : 0,
+                 has_location ? header.function : "",
+                 msg.time,
+                 header.thread_id});
+}
+
+bool HertLogBackend::on_backend_thread()
+{
+  return t_is_backend_thread;
+}
+
+void HertLogBackend::never_block_current_thread()
+{
+  t_never_blocks = true;
+}
+
+}  // namespace Hert
@@ -0,0 +1,384 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+#include "Hert/HertLogArgs.hpp"
+#include "HertLogBinaryWriter.hpp"
+#include "HertLogClock.hpp"
+#include "HertLogJsonWriter.hpp"
+
+namespace Hert
+{
+
+namespace detail
+{
+/**
+ * @brief 把"[分类] [文件名:行号] [函数名] "前缀直接写入输出缓冲区
+ */
+inline void append_location(fmt::memory_buffer& out,
+                            const char* category,
+                            const char* basename,
+                            int line,
+                            const char* function)
+{
+  if (category != nullptr) {
+    out.push_back('[');
+    out.append(std::string_view(category));
+    out.append(std::string_view("] "));
+  }
+  const std::string_view name(basename);
+  const std::string_view func(function);
+  const fmt::format_int line_text(line);
+  out.push_back('[');
+  out.append(name.data(), name.data() + name.size());
+  out.push_back(':');
+  out.append(line_text.data(), line_text.data() + line_text.size());
+  out.append(std::string_view("] ["));
+  out.append(func.data(), func.data() + func.size());
+  out.append(std::string_view("] "));
+}
+}  // namespace detail
+
+/**
+ * @brief 队列中记录的类型
+ */
+enum class LogRecordKind : std::uint8_t
+{
+  PADDING = 0,  // 环形缓冲区尾部的填充
+  FORMATTED = 1,  // 已在调用线程格式化的文本
+  DEFERRED = 2,  // 原始参数，由后端格式化；codec带json时为结构化记录
+};
+
+/**
+ * @brief 队列中每条记录的定长头部，参数区紧随其后
+ */
+struct LogRecordHeader
+{
+  std::uint32_t size;  // 含头部与对齐填充的总字节数
+  LogRecordKind kind;
+  LogLevel level;
+  std::uint32_t payload_size;  // 头部之后有效数据的字节数
+  int line;
+  const char* category;  // 静态存储的分类名，可为空
+  const char* file;
+  const char* basename;  // 调用点编译期截取的文件名
+  const char* function;
+  const detail::DeferredCodec* codec;
+  const char* format_data;
+  std::size_t format_size;
+  // 入队时为HertLogClock的读数，处理前由后台线程换算为system_clock
+  // 纪元以来的纳秒数
+  std::int64_t time_ns;
+  std::size_t thread_id;
+};
+
+/**
+ * @brief 变长记录的单生产者单消费者无锁环形缓冲区
+ *
+ * 记录按8字节对齐连续存放，尾部空间不足时写入填充记录后回绕。
+ * prepare/commit只能由生产者线程调用，front/pop只能由消费者线程调用。
+ */
+class LogRingBuffer
+{
+public:
+  explicit LogRingBuffer(std::size_t capacity);
+
+  /**
+   * @brief 预留size字节的连续空间，空间不足时返回nullptr
+   */
+  std::byte* prepare(std::size_t size);
+
+  /**
+   * @brief 提交最近一次prepare的记录
+   */
+  void commit(std::size_t size)
+  {
+    m_write_pos.store(m_write_pos.load(std::memory_order_relaxed) + size,
+                      std::memory_order_release);
+  }
+
+  /**
+   * @brief 读取位置处的记录，为空时返回nullptr
+   */
+  const LogRecordHeader* front() const;
+  LogRecordHeader* front()
+  {
+    return const_cast<LogRecordHeader*>(std::as_const(*this).front());
+  }
+
+  /**
+   * @brief 释放读取位置处的记录
+   */
+  void pop(std::size_t size)
+  {
+    m_read_pos.store(m_read_pos.load(std::memory_order_relaxed) + size,
+                     std::memory_order_release);
+  }
+
+  bool empty() const
+  {
+    return m_read_pos.load(std::memory_order_acquire)
+        == m_write_pos.load(std::memory_order_acquire);
+  }
+
+  std::uint64_t read_pos() const
+  {
+    return m_read_pos.load(std::memory_order_acquire);
+  }
+
+  std::uint64_t write_pos() const
+  {
+    return m_write_pos.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const { return m_storage.size(); }
+
+  /**
+   * @brief 单条记录允许的最大字节数
+   */
+  std::size_t max_record_size() const { return m_storage.size() / 4; }
+
+  static std::size_t aligned_size(std::size_t size)
+  {
+    return (size + 7U) & ~static_cast<std::size_t>(7U);
+  }
+
+private:
+  std::vector<std::byte> m_storage;
+  std::size_t m_mask;
+  // 读写位置分处不同缓存行，避免生产者与消费者伪共享
+  alignas(64) std::atomic<std::uint64_t> m_write_pos {0};
+  std::uint64_t m_cached_read_pos = 0;  // 生产者缓存的读位置
+  alignas(64) std::atomic<std::uint64_t> m_read_pos {0};
+};
+
+/**
+ * @brief 单个生产者线程的日志队列
+ */
+struct LogThreadQueue
+{
+  LogThreadQueue(std::size_t capacity, std::size_t urgent_capacity)
+      : ring(capacity)
+      , urgent(urgent_capacity)
+  {
+  }
+
+  /**
+   * @brief 按级别选择通道
+   */
+  LogRingBuffer& lane(LogLevel level)
+  {
+    return level >= LogLevel::ERROR ? urgent : ring;
+  }
+
+  LogRingBuffer ring;
+  LogRingBuffer urgent;  // ERROR及以上级别的通道，满时只等待不丢弃
+  // OVERWRITE_OLDEST策略下生产者丢弃ring中的旧记录，与后端读取互斥
+  std::mutex discard_mutex;
+  // 后台线程缓存的ring队首时间戳，仅OVERWRITE_OLDEST策略使用：读位置
+  // 未变时队首没有被丢弃，挑选时不必加锁
+  std::uint64_t cached_head_pos = 0;
+  std::int64_t cached_head_time = 0;
+  bool cached_head = false;
+  // 丢弃计数只由所属线程写入
+  std::atomic<std::uint64_t> dropped {0};
+  std::atomic<std::uint64_t> overwritten {0};
+  std::atomic<std::uint64_t> timed_out {0};
+  std::atomic<bool> retired {false};  // 所属线程已退出
+};
+
+/**
+ * @brief 按队列压力自动提升最低级别的参数
+ *
+ * 占用或排队延迟越过高水位时把最低级别提升到level，两者都回落到低水位
+ * 以下且持续一段时间后恢复，切换时各输出一条标记记录。
+ */
+struct LogShedConfig
+{
+  double high_ratio = 0;  // 单个队列的占用比例，0为不按占用
+  double low_ratio = 0;
+  std::chrono::milliseconds latency {0};  // 排队延迟，0为不按延迟
+  LogLevel level = LogLevel::WARN;
+
+  bool enabled() const { return high_ratio > 0 || latency.count() > 0; }
+};
+
+/**
+ * @brief 合并刷新的参数
+ *
+ * 达到level的记录不立即刷新，而是要求在latency内刷新，窗口内的多条
+ * 记录只触发一次flush(及file_sync要求的落盘)。另可按间隔或累计字节数
+ * 刷新，interval即普通记录的最长持久化延迟。
+ */
+struct LogFlushConfig
+{
+  LogLevel level = LogLevel::ERROR;
+  std::chrono::milliseconds latency {0};  // 为零时达到level立即刷新
+  std::chrono::milliseconds interval {0};  // 为零时不定期刷新
+  std::size_t bytes = 0;  // 为零时不按字节刷新
+};
+
+/**
+ * @brief 异步日志后端
+ *
+ * 每个生产者线程首次写日志时惰性创建自己的无锁SPSC队列，前端只把
+ * 记录头和原始参数拷贝进本线程队列；唯一的后台线程按时间戳归并各
+ * 队列，负责解码、格式化、写入sink并调用自定义处理器。
+ *
+ * 每个线程另有一条ERROR及以上级别专用的通道，与普通通道一起按时间戳
+ * 归并。普通通道写满时按溢出策略等待或丢弃，ERROR通道总是等待，不会
+ * 因为大量低级别日志而丢失错误。
+ */
+class HertLogBackend
+{
+public:
+  /**
+   * @param logger 持有sink的同步日志器
+   * @param queue_bytes 每个线程队列的字节数
+   * @param overflow_policy 普通通道已满时的处理方式
+   * @param block_timeout BLOCK策略的最长等待，为零时一直等待
+   * @param report_interval 输出丢弃统计的间隔，为零时不输出
+   * @param shed 自动降载的参数
+   * @param flush 合并刷新的参数
+   * @param clock_source 记录时间戳的时钟源
+   * @param binary_writer 可选的二进制日志输出
+   * @param json_writer 可选的JSON-lines日志输出
+   */
+  HertLogBackend(std::shared_ptr<spdlog::logger> logger,
+                 std::size_t queue_bytes,
+                 LogOverflowPolicy overflow_policy,
+                 std::chrono::milliseconds block_timeout,
+                 std::chrono::milliseconds report_interval,
+                 const LogShedConfig& shed,
+                 const LogFlushConfig& flush,
+                 LogClockSource clock_source,
+                 std::unique_ptr<HertLogBinaryWriter> binary_writer = nullptr,
+                 std::unique_ptr<HertLogJsonWriter> json_writer = nullptr);
+  ~HertLogBackend();
+
+  HertLogBackend(const HertLogBackend&) = delete;
+  HertLogBackend& operator=(const HertLogBackend&) = delete;
+  HertLogBackend(HertLogBackend&&) = delete;
+  HertLogBackend& operator=(HertLogBackend&&) = delete;
+
+  /**
+   * @brief 写入一条已格式化的消息
+   */
+  void push_formatted(LogLevel level,
+                      const char* category,
+                      const LogSite* site,
+                      const char* function,
+                      std::string_view message);
+
+  /**
+   * @brief 写入一条待格式化的记录
+   * @return 记录过大无法入队时返回false
+   */
+  bool push_deferred(LogLevel level,
+                     const LogSite* site,
+                     const char* function,
+                     const char* category,
+                     const detail::DeferredCodec* codec,
+                     fmt::string_view format,
+                     const std::byte* args,
+                     std::size_t args_size);
+
+  /**
+   * @brief 等待此前入队的记录全部输出后刷新sink
+   * @return 后台线程5秒内没有处理到此前的记录时返回false
+   */
+  bool flush();
+
+  /**
+   * @brief 累计的丢弃统计，含已退出线程的队列与各sink的独立队列
+   */
+  LogDropStats drop_stats();
+
+  /**
+   * @brief 当前线程此后入队时从不等待，队列已满即丢弃并计数
+   *
+   * 供fd捕获的读取线程使用：它等待时应用写stdout/stderr也会被卡住。
+   */
+  static void never_block_current_thread();
+
+  /**
+   * @brief 实际使用的时钟源，TSC不可用时为SYSTEM
+   */
+  LogClockSource clock_source() const { return m_clock.source(); }
+
+private:
+  bool push(const LogRecordHeader& header,
+            const std::byte* payload,
+            std::size_t payload_size);
+  std::byte* make_room(LogThreadQueue& queue,
+                       LogRingBuffer& ring,
+                       std::size_t size);
+  LogThreadQueue& local_queue();
+  void run();
+  bool drain_one(std::vector<std::shared_ptr<LogThreadQueue>>& queues);
+  bool ring_head_time(LogThreadQueue& queue, std::int64_t& time);
+  void process(LogRecordHeader& header);
+  void request_flush(LogLevel level, std::size_t bytes);
+  void flush_if_due(std::chrono::steady_clock::time_point now);
+  void flush_outputs();
+  void housekeeping(const std::vector<std::shared_ptr<LogThreadQueue>>& queues);
+  void report_drops();
+  void update_shedding(
+      const std::vector<std::shared_ptr<LogThreadQueue>>& queues);
+  void wake_consumer();
+  void notify_space();
+  static bool on_backend_thread();
+
+  std::shared_ptr<spdlog::logger> m_logger;
+  std::unique_ptr<HertLogBinaryWriter> m_binary_writer;
+  std::unique_ptr<HertLogJsonWriter> m_json_writer;
+  std::size_t m_queue_bytes;
+  const LogOverflowPolicy m_overflow_policy;
+  const std::chrono::milliseconds m_block_timeout;
+  const std::chrono::milliseconds m_report_interval;
+  const LogShedConfig m_shed;
+  const LogFlushConfig m_flush;
+  const std::uint64_t m_generation;  // 区分先后创建的后端实例
+  HertLogClock m_clock;
+
+  // 线程队列列表，仅在注册新线程时加锁
+  std::mutex m_queues_mutex;
+  std::vector<std::shared_ptr<LogThreadQueue>> m_queues;
+  std::atomic<std::uint64_t> m_queues_version {0};
+  LogDropStats m_retired_drops;  // 已回收队列的丢弃计数，受m_queues_mutex保护
+
+  // 以下只由后台线程访问
+  std::vector<std::uint64_t> m_scratch;  // 可被覆盖的记录先拷贝到这里再处理
+  LogDropStats m_reported_drops;
+  std::chrono::steady_clock::time_point m_next_report;
+  bool m_shedding = false;
+  std::chrono::steady_clock::time_point m_shed_since;
+  // 下一次必须刷新的时刻与上次刷新以来写入的字节数
+  std::chrono::steady_clock::time_point m_flush_due;
+  std::size_t m_unflushed_bytes = 0;
+
+  // 后台线程空闲时在此休眠
+  std::mutex m_wait_mutex;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_drained;
+  std::condition_variable m_space_freed;  // BLOCK策略的生产者在此等待空间
+  std::atomic<bool> m_sleeping {false};
+  std::atomic<std::size_t> m_flush_waiters {0};
+  std::atomic<std::size_t> m_space_waiters {0};
+  std::atomic<bool> m_copied_pending {false};  // 已出队但尚未写出的记录
+  std::atomic<bool> m_stop {false};
+  std::thread m_thread;
+};
+
+}  // namespace Hert
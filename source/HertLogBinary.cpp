@@ -0,0 +1,457 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include "Hert/HertLogBinary.hpp"
+
+#include "HertLogArchiver.hpp"
+#include "HertLogBackend.hpp"
+#include "HertLogBinaryWriter.hpp"
+#include "HertLogDiagnostics.hpp"
+
+#include <fmt/args.h>
+#include <spdlog/sinks/rotating_file_sink.h>
+#include <zlib.h>
+
+namespace Hert
+{
+
+namespace
+{
+void write_string(fmt::memory_buffer& out, std::string_view value)
+{
+  detail::write_varint(out, value.size());
+  out.append(value.data(), value.data() + value.size());
+}
+
+std::string_view or_empty(const char* text)
+{
+  return text ? std::string_view(text) : std::string_view();
+}
+}  // anonymous namespace
+
+// ============ 写入器 ============
+
+std::size_t HertLogBinaryWriter::SiteKeyHash::operator()(
+    const SiteKey& key) const
+{
+  std::size_t hash = std::hash<std::string_view> {}(key.format);
+  const auto combine = [&hash](std::size_t value)
+  { hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6U) + (hash >> 2U); };
+  combine(std::hash<const char*> {}(key.category));
+  combine(std::hash<const char*> {}(key.file));
+  combine(std::hash<int> {}(key.line));
+  combine(std::hash<const char*> {}(key.function));
+  return hash;
+}
+
+HertLogBinaryWriter::HertLogBinaryWriter(
+    std::string path,
+    LogLevel level,
+    std::size_t max_file_size,
+    std::size_t max_files,
+    std::shared_ptr<HertLogArchiver> archiver)
+    : m_path(std::move(path))
+    , m_level(level)
+    , m_max_file_size(max_file_size)
+    , m_max_files(max_files)
+    , m_archiver(std::move(archiver))
+{
+  std::filesystem::path log_path(m_path);
+  if (log_path.has_parent_path()) {
+    std::filesystem::create_directories(log_path.parent_path());
+  }
+  if (m_archiver) {
+    for (const auto& [index, segment] : detail::list_log_segments(m_path)) {
+      m_next_index = index + 1;
+      if (!segment.ends_with(".gz")) {
+        m_archiver->submit(segment, m_path, m_max_files);
+      }
+    }
+  }
+  open(false);
+}
+
+HertLogBinaryWriter::~HertLogBinaryWriter()
+{
+  if (m_file) {
+    std::fclose(m_file);
+  }
+}
+
+void HertLogBinaryWriter::open(bool truncate)
+{
+  m_file = std::fopen(m_path.c_str(), truncate ? "wb" : "ab");
+  if (!m_file) {
+    throw std::runtime_error("Failed to open binary log file: " + m_path);
+  }
+  std::fseek(m_file, 0, SEEK_END);
+  const long size = std::ftell(m_file);
+  m_file_size = size > 0 ? static_cast<std::size_t>(size) : 0;
+
+  // 每次打开都开始新的会话，调用点编号与时间基准从头计算
+  m_sites.clear();
+  m_formats.clear();
+  m_last_time_ns = 0;
+  m_buffer.clear();
+  m_buffer.append(binlog::kMagic, binlog::kMagic + sizeof(binlog::kMagic));
+  m_buffer.push_back(static_cast<char>(binlog::kVersion));
+  write_buffer();
+}
+
+void HertLogBinaryWriter::rotate()
+{
+  std::fclose(m_file);
+  m_file = nullptr;
+
+  std::error_code error;
+  if (m_archiver) {
+    // 只重命名当前文件，压缩与清理由压缩器在后台完成
+    const auto rotated = detail::log_segment_path(m_path, m_next_index++);
+    std::filesystem::rename(m_path, rotated, error);
+    if (!error) {
+      m_archiver->submit(rotated, m_path, m_max_files);
+    }
+    open(!error);
+    return;
+  }
+
+  // 与rotating_file_sink相同：hert.hlog -> hert.1.hlog -> hert.2.hlog ...
+  using rotating_sink = spdlog::sinks::rotating_file_sink_mt;
+  for (std::size_t i = m_max_files; i > 0; --i) {
+    const auto source = rotating_sink::calc_filename(m_path, i - 1);
+    if (!std::filesystem::exists(source, error)) {
+      continue;
+    }
+    const auto target = rotating_sink::calc_filename(m_path, i);
+    std::filesystem::remove(target, error);
+    std::filesystem::rename(source, target, error);
+  }
+  open(true);
+}
+
+void HertLogBinaryWriter::write_buffer()
+{
+  if (std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file)
+      != m_buffer.size())
+  {
+    detail::diagnostics() << "Failed to write binary log file: " << m_path
+                          << '\n';
+  }
+  m_file_size += m_buffer.size();
+}
+
+std::uint32_t HertLogBinaryWriter::intern(const LogRecordHeader& header,
+                                          std::string_view format)
+{
+  const SiteKey key {
+      format, header.category, header.file, header.line, header.function};
+  const auto found = m_sites.find(key);
+  if (found != m_sites.end()) {
+    return found->second;
+  }
+
+  const auto id = static_cast<std::uint32_t>(m_sites.size());
+  SiteKey stored = key;
+  stored.format = m_formats.emplace_back(format);
+  m_sites.emplace(stored, id);
+
+  m_buffer.push_back(static_cast<char>(binlog::RecordType::SITE));
+  detail::write_varint(m_buffer, id);
+  write_string(m_buffer, or_empty(header.category));
+  write_string(m_buffer, or_empty(header.file));
+  detail::write_varint(m_buffer, static_cast<std::uint32_t>(header.line));
+  write_string(m_buffer, or_empty(header.function));
+  write_string(m_buffer, format);
+  return id;
+}
+
+void HertLogBinaryWriter::write(const LogRecordHeader& header)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_file) {
+    return;
+  }
+
+  const auto* payload = reinterpret_cast<const std::byte*>(&header + 1);
+  const bool deferred = header.kind == LogRecordKind::DEFERRED;
+  const std::string_view format = deferred
+      ? std::string_view(header.format_data, header.format_size)
+      : std::string_view("{}");
+
+  const auto encode = [&]
+  {
+    m_buffer.clear();
+    const std::uint32_t id = intern(header, format);
+    m_buffer.push_back(static_cast<char>(binlog::RecordType::RECORD));
+    detail::write_varint(m_buffer, id);
+    m_buffer.push_back(static_cast<char>(header.level));
+    detail::write_varint(m_buffer,
+                         detail::zigzag_encode(header.time_ns - m_last_time_ns));
+    detail::write_varint(m_buffer, header.thread_id);
+    if (deferred) {
+      header.codec->serialize(payload, m_buffer);
+    } else {
+      detail::write_varint(m_buffer, 1);
+      detail::write_binary_arg(
+          m_buffer,
+          std::string_view(reinterpret_cast<const char*>(payload),
+                           header.payload_size));
+    }
+  };
+
+  encode();
+  if (m_max_file_size > 0 && m_file_size > binlog::kHeaderSize
+      && m_file_size + m_buffer.size() > m_max_file_size)
+  {
+    // 新文件重新开始会话，需要按新的调用点表重新编码
+    rotate();
+    if (!m_file) {
+      return;
+    }
+    encode();
+  }
+  m_last_time_ns = header.time_ns;
+  write_buffer();
+}
+
+void HertLogBinaryWriter::flush()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_file) {
+    std::fflush(m_file);
+  }
+}
+
+// ============ 读取器 ============
+
+HertLogBinaryReader::HertLogBinaryReader(const std::string& path)
+    : m_input(gzopen(path.c_str(), "rb"))
+{
+  // gzread对未压缩的文件原样读取，压缩归档与当前文件走同一条路径
+  if (!m_input) {
+    throw std::runtime_error("Failed to open binary log file: " + path);
+  }
+  if (!read_header()) {
+    gzclose(m_input);
+    throw std::runtime_error("Not a Hert binary log file: " + path);
+  }
+}
+
+HertLogBinaryReader::~HertLogBinaryReader()
+{
+  gzclose(m_input);
+}
+
+int HertLogBinaryReader::get()
+{
+  return gzgetc(m_input);
+}
+
+int HertLogBinaryReader::peek()
+{
+  const int byte = gzgetc(m_input);
+  if (byte != -1) {
+    gzungetc(byte, m_input);
+  }
+  return byte;
+}
+
+bool HertLogBinaryReader::read(void* data, std::size_t size)
+{
+  return size == 0
+      || gzread(m_input, data, static_cast<unsigned>(size))
+      == static_cast<int>(size);
+}
+
+bool HertLogBinaryReader::read_header()
+{
+  char header[binlog::kHeaderSize];
+  if (!read(header, sizeof(header))) {
+    return false;
+  }
+  if (std::string_view(header, sizeof(binlog::kMagic))
+          != std::string_view(binlog::kMagic, sizeof(binlog::kMagic))
+      || static_cast<std::uint8_t>(header[sizeof(binlog::kMagic)])
+          != binlog::kVersion)
+  {
+    return false;
+  }
+  m_sites.clear();
+  m_last_time_ns = 0;
+  return true;
+}
+
+bool HertLogBinaryReader::read_varint(std::uint64_t& value)
+{
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    const int byte = get();
+    if (byte == -1) {
+      return false;
+    }
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  throw std::runtime_error("Corrupted binary log: varint too long");
+}
+
+bool HertLogBinaryReader::read_string(std::string& value)
+{
+  std::uint64_t size = 0;
+  if (!read_varint(size)) {
+    return false;
+  }
+  value.resize(static_cast<std::size_t>(size));
+  return read(value.data(), value.size());
+}
+
+bool HertLogBinaryReader::next(BinaryLogEntry& entry)
+{
+  for (;;) {
+    const int type = peek();
+    if (type == -1) {
+      return false;
+    }
+    if (type == binlog::kMagic[0]) {
+      // 追加写入的新会话
+      if (!read_header()) {
+        throw std::runtime_error("Corrupted binary log: bad session header");
+      }
+      continue;
+    }
+    get();
+    if (type == static_cast<int>(binlog::RecordType::SITE)) {
+      if (!read_site()) {
+        return false;
+      }
+    } else if (type == static_cast<int>(binlog::RecordType::RECORD)) {
+      return read_record(entry);
+    } else {
+      throw std::runtime_error("Corrupted binary log: unknown record type");
+    }
+  }
+}
+
+bool HertLogBinaryReader::read_site()
+{
+  std::uint64_t id = 0;
+  std::uint64_t line = 0;
+  Site site;
+  if (!read_varint(id) || !read_string(site.category)
+      || !read_string(site.file) || !read_varint(line)
+      || !read_string(site.function) || !read_string(site.format))
+  {
+    return false;
+  }
+  if (id != m_sites.size()) {
+    throw std::runtime_error("Corrupted binary log: unexpected site id");
+  }
+  site.line = static_cast<int>(line);
+  m_sites.push_back(std::move(site));
+  return true;
+}
+
+bool HertLogBinaryReader::read_record(BinaryLogEntry& entry)
+{
+  std::uint64_t id = 0;
+  std::uint64_t time_delta = 0;
+  std::uint64_t thread_id = 0;
+  std::uint64_t arg_count = 0;
+  if (!read_varint(id)) {
+    return false;
+  }
+  const int level = get();
+  if (level == -1 || !read_varint(time_delta)
+      || !read_varint(thread_id) || !read_varint(arg_count))
+  {
+    return false;
+  }
+  if (id >= m_sites.size() || level > static_cast<int>(LogLevel::OFF)) {
+    throw std::runtime_error("Corrupted binary log: bad record header");
+  }
+
+  fmt::dynamic_format_arg_store<fmt::format_context> args;
+  for (std::uint64_t i = 0; i < arg_count; ++i) {
+    const int tag = get();
+    std::uint64_t value = 0;
+    switch (static_cast<detail::BinaryArgType>(tag)) {
+      case detail::BinaryArgType::SIGNED:
+        if (!read_varint(value)) {
+          return false;
+        }
+        args.push_back(detail::zigzag_decode(value));
+        break;
+      case detail::BinaryArgType::UNSIGNED:
+        if (!read_varint(value)) {
+          return false;
+        }
+        args.push_back(value);
+        break;
+      case detail::BinaryArgType::FLOAT: {
+        float number = 0;
+        if (!read(&number, sizeof(number))) {
+          return false;
+        }
+        args.push_back(number);
+        break;
+      }
+      case detail::BinaryArgType::DOUBLE: {
+        double number = 0;
+        if (!read(&number, sizeof(number))) {
+          return false;
+        }
+        args.push_back(number);
+        break;
+      }
+      case detail::BinaryArgType::BOOL: {
+        const int flag = get();
+        if (flag == -1) {
+          return false;
+        }
+        args.push_back(flag != 0);
+        break;
+      }
+      case detail::BinaryArgType::CHAR:
+        if (!read_varint(value)) {
+          return false;
+        }
+        args.push_back(static_cast<char>(value));
+        break;
+      case detail::BinaryArgType::STRING: {
+        std::string text;
+        if (!read_string(text)) {
+          return false;
+        }
+        args.push_back(std::move(text));
+        break;
+      }
+      default:
+        if (tag == -1) {
+          return false;
+        }
+        throw std::runtime_error("Corrupted binary log: unknown argument type");
+    }
+  }
+
+  const Site& site = m_sites[static_cast<std::size_t>(id)];
+  m_last_time_ns += detail::zigzag_decode(time_delta);
+  entry.level = static_cast<LogLevel>(level);
+  entry.category = site.category;
+  entry.file = site.file;
+  entry.line = site.line;
+  entry.function = site.function;
+  entry.time = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::nanoseconds(m_last_time_ns)));
+  entry.thread_id = static_cast<size_t>(thread_id);
+  try {
+    entry.message = fmt::vformat(site.format, args);
+  } catch (const std::exception& e) {
+    entry.message = fmt::format("Log format error: {}", e.what());
+  }
+  return true;
+}
+
+}  // namespace Hert
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Hert/HertLog.hpp"
+
+namespace Hert
+{
+
+struct LogRecordHeader;
+class HertLogArchiver;
+
+/**
+ * @brief 二进制日志写入器，只由后端线程写入
+ *
+ * 延迟格式化的记录直接把参数区转写为变长编码，不经过文本格式化；
+ * 调用线程已格式化的记录以"{}"加一个字符串参数保存。
+ * 文件超过大小上限时按文本日志相同的命名规则轮转。
+ */
+class HertLogBinaryWriter
+{
+public:
+  /**
+   * @param archiver 轮转出的文件交给它压缩，为空时按rotating_file_sink的
+   *        规则逐个重命名
+   * @throws std::runtime_error 文件无法打开
+   */
+  HertLogBinaryWriter(std::string path,
+                      LogLevel level,
+                      std::size_t max_file_size,
+                      std::size_t max_files,
+                      std::shared_ptr<HertLogArchiver> archiver = nullptr);
+  ~HertLogBinaryWriter();
+
+  HertLogBinaryWriter(const HertLogBinaryWriter&) = delete;
+  HertLogBinaryWriter& operator=(const HertLogBinaryWriter&) = delete;
+  HertLogBinaryWriter(HertLogBinaryWriter&&) = delete;
+  HertLogBinaryWriter& operator=(HertLogBinaryWriter&&) = delete;
+
+  LogLevel level() const { return m_level; }
+
+  /**
+   * @brief 写入一条队列记录，参数区紧随头部
+   */
+  void write(const LogRecordHeader& header);
+
+  void flush();
+
+private:
+  // 调用点以格式串内容和静态字符串指针区分
+  struct SiteKey
+  {
+    std::string_view format;
+    const char* category;
+    const char* file;
+    int line;
+    const char* function;
+
+    bool operator==(const SiteKey&) const = default;
+  };
+
+  struct SiteKeyHash
+  {
+    std::size_t operator()(const SiteKey& key) const;
+  };
+
+  std::uint32_t intern(const LogRecordHeader& header, std::string_view format);
+  void open(bool truncate);
+  void rotate();
+  void write_buffer();
+
+  std::string m_path;
+  LogLevel m_level;
+  std::size_t m_max_file_size;
+  std::size_t m_max_files;
+  std::shared_ptr<HertLogArchiver> m_archiver;
+  std::uint64_t m_next_index = 1;  // 压缩时轮转文件的序号
+
+  std::mutex m_mutex;  // flush可能来自其他线程
+  std::FILE* m_file = nullptr;
+  std::size_t m_file_size = 0;
+  std::int64_t m_last_time_ns = 0;
+  fmt::memory_buffer m_buffer;  // 当前文件中待写入的一段数据
+  std::unordered_map<SiteKey, std::uint32_t, SiteKeyHash> m_sites;
+  std::deque<std::string> m_formats;  // SiteKey::format引用的格式串副本
+};
+
+}  // namespace Hert
@@ -0,0 +1,117 @@
+#include <algorithm>
+
+#include "HertLogCategory.hpp"
+
+namespace Hert
+{
+
+// ============ LogCategory ============
+
+LogCategory::LogCategory(std::string_view name)
+    : m_name(detail::LogCategoryRegistry::instance().intern(name))
+{
+  detail::LogCategoryRegistry::instance().add(*this);
+}
+
+LogCategory::~LogCategory()
+{
+  detail::LogCategoryRegistry::instance().remove(*this);
+}
+
+// ============ LogCategoryRegistry ============
+
+detail::LogCategoryRegistry& detail::LogCategoryRegistry::instance()
+{
+  // 静态分类的析构可能晚于普通静态对象，注册表保留到进程退出
+  static auto* registry = new LogCategoryRegistry();
+  return *registry;
+}
+
+void detail::LogCategoryRegistry::add(LogCategory& category)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_categories.push_back(&category);
+  category.m_level.store(effective_level(category.m_name),
+                         std::memory_order_relaxed);
+}
+
+void detail::LogCategoryRegistry::remove(LogCategory& category)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_categories.erase(
+      std::remove(m_categories.begin(), m_categories.end(), &category),
+      m_categories.end());
+}
+
+LogCategory& detail::LogCategoryRegistry::named(std::string_view name)
+{
+  std::lock_guard<std::mutex> lock(m_named_mutex);
+  auto found = m_named.find(name);
+  if (found == m_named.end()) {
+    found = m_named
+                .emplace(std::string(name), std::make_unique<LogCategory>(name))
+                .first;
+  }
+  return *found->second;
+}
+
+const char* detail::LogCategoryRegistry::intern(std::string_view name)
+{
+  std::lock_guard<std::mutex> lock(m_names_mutex);
+  auto found = m_names.find(name);
+  if (found == m_names.end()) {
+    found = m_names.emplace(name).first;
+  }
+  return found->c_str();
+}
+
+void detail::LogCategoryRegistry::set_level(std::string_view name,
+                                            std::optional<LogLevel> level)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (level) {
+    m_levels.insert_or_assign(std::string(name), *level);
+  } else if (const auto found = m_levels.find(name); found != m_levels.end()) {
+    m_levels.erase(found);
+  }
+  refresh();
+}
+
+void detail::LogCategoryRegistry::set_root_level(LogLevel level,
+                                                 LogLevel floor,
+                                                 bool enabled)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_root_level = level;
+  m_floor = floor;
+  m_enabled = enabled;
+  refresh();
+}
+
+LogLevel detail::LogCategoryRegistry::effective_level(
+    std::string_view name) const
+{
+  if (!m_enabled) {
+    return LogLevel::OFF;  // 日志系统未初始化
+  }
+  // 取名称最长(最近)的已设置祖先
+  LogLevel level = m_root_level;
+  std::size_t matched = 0;
+  for (const auto& [prefix, prefix_level] : m_levels) {
+    if (prefix.size() >= matched && category_matches(prefix, name)) {
+      level = prefix_level;
+      matched = prefix.size();
+    }
+  }
+  return std::max(level, m_floor);
+}
+
+void detail::LogCategoryRegistry::refresh()
+{
+  for (LogCategory* category : m_categories) {
+    category->m_level.store(effective_level(category->m_name),
+                            std::memory_order_relaxed);
+  }
+}
+
+}  // namespace Hert
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+
+namespace Hert::detail
+{
+
+/**
+ * @brief 分类按"."分层，过滤名匹配自身及所有子分类，空过滤名匹配全部
+ */
+inline bool category_matches(std::string_view filter, std::string_view category)
+{
+  if (filter.empty() || category == filter) {
+    return true;
+  }
+  return category.size() > filter.size() && category.starts_with(filter)
+      && category[filter.size()] == '.';
+}
+
+/**
+ * @brief 所有LogCategory的注册表
+ *
+ * 保存显式设置的分类级别与全局级别，任一变化时在锁内重新计算每个
+ * 分类的生效级别并写入其原子变量，写日志的线程从不访问注册表。
+ */
+class LogCategoryRegistry
+{
+public:
+  static LogCategoryRegistry& instance();
+
+  void add(LogCategory& category);
+  void remove(LogCategory& category);
+
+  /**
+   * @brief 按名称取得运行时创建的分类，不存在时创建
+   *
+   * 供Qt等外部分类映射使用，创建的分类随注册表保留到进程退出。
+   */
+  LogCategory& named(std::string_view name);
+
+  /**
+   * @brief 返回名称的驻留副本，同名返回同一指针，保留到进程退出
+   */
+  const char* intern(std::string_view name);
+
+  /**
+   * @brief 设置或清除(level为空)某个分类的显式级别
+   */
+  void set_level(std::string_view name, std::optional<LogLevel> level);
+
+  /**
+   * @brief 更新全局级别与日志系统是否可用，不可用时所有分类为OFF
+   * @param floor 降载期间的下限，分类的生效级别不低于它
+   */
+  void set_root_level(LogLevel level, LogLevel floor, bool enabled);
+
+private:
+  LogCategoryRegistry() = default;
+
+  LogLevel effective_level(std::string_view name) const;
+  void refresh();
+
+  std::mutex m_mutex;
+  std::vector<LogCategory*> m_categories;
+  std::map<std::string, LogLevel, std::less<>> m_levels;
+  std::mutex m_named_mutex;  // 分类构造时要取m_mutex，与之分开
+  std::map<std::string, std::unique_ptr<LogCategory>, std::less<>> m_named;
+  std::mutex m_names_mutex;
+  std::set<std::string, std::less<>> m_names;  // 节点不移动，c_str()稳定
+  LogLevel m_root_level = LogLevel::INFO;
+  LogLevel m_floor = LogLevel::TRACE;
+  bool m_enabled = false;
+};
+
+}  // namespace Hert::detail
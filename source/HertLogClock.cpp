@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "HertLogClock.hpp"
+
+#if HERT_HAS_TSC_CLOCK
+#  include <cpuid.h>
+#endif
+
+namespace Hert
+{
+
+namespace
+{
+constexpr auto kCalibrationInterval = std::chrono::seconds(1);
+// 初次测量频率的时长，决定initialize的额外耗时
+constexpr auto kInitialCalibration = std::chrono::milliseconds(10);
+// 两次校准间频率变化超过该比例时视为系统时间被调整，只移动基点
+constexpr double kMaxRateChange = 0.001;
+// 取样时一次读取系统时间前后的TSC，取间隔最短的一次
+constexpr int kSampleAttempts = 5;
+
+bool invariant_tsc()
+{
+#if HERT_HAS_TSC_CLOCK
+  unsigned eax = 0;
+  unsigned ebx = 0;
+  unsigned ecx = 0;
+  unsigned edx = 0;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1U << 8U)) != 0;  // 不随频率与休眠状态变化
+#else
+  return false;
+#endif
+}
+}  // anonymous namespace
+
+HertLogClock::HertLogClock(LogClockSource source)
+{
+  if (source != LogClockSource::TSC || !invariant_tsc()) {
+    return;
+  }
+  const Sample start = sample();
+  std::this_thread::sleep_for(kInitialCalibration);
+  const Sample end = sample();
+  if (end.ticks <= start.ticks) {
+    return;
+  }
+  const double ns_per_tick = static_cast<double>(end.ns - start.ns)
+      / static_cast<double>(end.ticks - start.ticks);
+  // 0.1GHz到20GHz之外的结果说明TSC或系统时间不可信
+  if (!(ns_per_tick > 0.05 && ns_per_tick < 10)) {
+    return;
+  }
+  m_tsc = true;
+  m_base = end;
+  m_ns_per_tick = ns_per_tick;
+  m_next_calibration = std::chrono::steady_clock::now() + kCalibrationInterval;
+}
+
+std::int64_t HertLogClock::to_ns(std::int64_t stamp) const
+{
+  if (!m_tsc) {
+    return stamp;
+  }
+  return m_base.ns
+      + std::llround(static_cast<double>(stamp - m_base.ticks) * m_ns_per_tick);
+}
+
+std::int64_t HertLogClock::to_wall_ns(std::int64_t stamp)
+{
+  if (!m_tsc) {
+    return stamp;
+  }
+  m_last_wall_ns = std::max(to_ns(stamp), m_last_wall_ns);
+  return m_last_wall_ns;
+}
+
+void HertLogClock::calibrate_if_due(std::chrono::steady_clock::time_point now)
+{
+  if (m_tsc && now >= m_next_calibration) {
+    calibrate();
+    m_next_calibration = now + kCalibrationInterval;
+  }
+}
+
+HertLogClock::Sample HertLogClock::sample()
+{
+  Sample best {0, 0};
+#if HERT_HAS_TSC_CLOCK
+  std::int64_t best_span = 0;
+  for (int i = 0; i < kSampleAttempts; ++i) {
+    const auto before = static_cast<std::int64_t>(__rdtsc());
+    const std::int64_t ns = system_ns();
+    const auto after = static_cast<std::int64_t>(__rdtsc());
+    if (i == 0 || after - before < best_span) {
+      best_span = after - before;
+      best = Sample {before + best_span / 2, ns};
+    }
+  }
+#endif
+  return best;
+}
+
+void HertLogClock::calibrate()
+{
+  const Sample current = sample();
+  if (current.ticks > m_base.ticks) {
+    const double rate = static_cast<double>(current.ns - m_base.ns)
+        / static_cast<double>(current.ticks - m_base.ticks);
+    if (std::abs(rate - m_ns_per_tick) <= m_ns_per_tick * kMaxRateChange) {
+      m_ns_per_tick = rate;
+    }
+  }
+  // 基点总是跟随系统时间，换算结果与CLOCK_REALTIME的偏差不会累积
+  m_base = current;
+}
+
+}  // namespace Hert
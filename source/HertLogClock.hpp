@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "Hert/HertLog.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+#  define HERT_HAS_TSC_CLOCK 1
+#  include <x86intrin.h>
+#else
+#  define HERT_HAS_TSC_CLOCK 0
+#endif
+
+namespace Hert
+{
+
+/**
+ * @brief 后端记录时间戳的时钟
+ *
+ * 生产者线程调用now()取读数，后台线程再用to_wall_ns()换算为system_clock
+ * 纪元以来的纳秒数。TSC模式下读数是rdtsc的计数值，换算用的基点与频率
+ * 由后台线程定期对照CLOCK_REALTIME校准。CPU不声明不变TSC(许多虚拟机
+ * 会隐藏该标志)或初次测得的频率不合理时退回system_clock。
+ */
+class HertLogClock
+{
+public:
+  explicit HertLogClock(LogClockSource source);
+
+  /**
+   * @brief 实际使用的时钟源
+   */
+  LogClockSource source() const
+  {
+    return m_tsc ? LogClockSource::TSC : LogClockSource::SYSTEM;
+  }
+
+  /**
+   * @brief 读取时钟，可在任意线程调用
+   */
+  std::int64_t now() const
+  {
+#if HERT_HAS_TSC_CLOCK
+    if (m_tsc) {
+      return static_cast<std::int64_t>(__rdtsc());
+    }
+#endif
+    return system_ns();
+  }
+
+  /**
+   * @brief 把读数换算为纳秒，不修改状态
+   */
+  std::int64_t to_ns(std::int64_t stamp) const;
+
+  /**
+   * @brief 按处理顺序换算记录的读数，TSC模式下结果单调不减
+   *
+   * 重新校准可能使换算结果回退，各线程的记录按读数顺序处理，
+   * 夹住回退即可保证每个线程的时间戳单调。只由后台线程调用。
+   */
+  std::int64_t to_wall_ns(std::int64_t stamp);
+
+  /**
+   * @brief 距上次校准超过间隔时重新校准，只由后台线程调用
+   */
+  void calibrate_if_due(std::chrono::steady_clock::time_point now);
+
+  static std::int64_t system_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  struct Sample
+  {
+    std::int64_t ticks;
+    std::int64_t ns;
+  };
+
+  static Sample sample();
+  void calibrate();
+
+  bool m_tsc = false;
+  Sample m_base {0, 0};  // 换算基点
+  double m_ns_per_tick = 1;
+  std::int64_t m_last_wall_ns = 0;
+  std::chrono::steady_clock::time_point m_next_calibration;
+};
+
+}  // namespace Hert
@@ -0,0 +1,99 @@
+#include "HertLogDedupSink.hpp"
+
+#include <spdlog/details/log_msg.h>
+
+namespace Hert
+{
+
+HertDedupSink::HertDedupSink(spdlog::sink_ptr target,
+                             std::chrono::milliseconds window)
+    : m_sink(std::move(target))
+    , m_window(window)
+{
+}
+
+HertDedupSink::~HertDedupSink()
+{
+  try {
+    std::lock_guard<std::mutex> lock(mutex_);
+    emit_repeated();
+    m_sink->flush();
+  } catch (...) {
+    // 析构中不能抛出异常
+  }
+}
+
+void HertDedupSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+  const std::string_view payload(msg.payload.data(), msg.payload.size());
+  if (msg.level == m_last_level && same_source(msg.source)
+      && payload == m_last_payload)
+  {
+    m_last_time = msg.time;
+    ++m_repeated;
+    if (msg.time - m_window_start < m_window) {
+      return;
+    }
+    // 窗口到期：汇总本窗口内的重复并开始新窗口，不重复输出原文
+    emit_repeated();
+    m_window_start = msg.time;
+    return;
+  }
+
+  emit_repeated();
+  m_sink->log(msg);
+  m_last_payload.assign(payload);
+  m_last_logger_name.assign(msg.logger_name.data(), msg.logger_name.size());
+  m_last_level = msg.level;
+  m_last_source = msg.source;
+  m_window_start = msg.time;
+}
+
+void HertDedupSink::flush_()
+{
+  // 重复停止后不再有记录触发汇总，由窗口到期后的刷新补上
+  const auto now = spdlog::log_clock::now();
+  if (m_repeated > 0 && now - m_window_start >= m_window) {
+    emit_repeated();
+    m_window_start = now;
+  }
+  m_sink->flush();
+}
+
+void HertDedupSink::set_pattern_(const std::string& pattern)
+{
+  m_sink->set_pattern(pattern);
+}
+
+void HertDedupSink::set_formatter_(std::unique_ptr<spdlog::formatter> formatter)
+{
+  m_sink->set_formatter(std::move(formatter));
+}
+
+bool HertDedupSink::same_source(const spdlog::source_loc& source) const
+{
+  return source.filename == m_last_source.filename
+      && source.line == m_last_source.line
+      && source.funcname == m_last_source.funcname;
+}
+
+void HertDedupSink::emit_repeated()
+{
+  if (m_repeated == 0) {
+    return;
+  }
+  fmt::memory_buffer text;
+  fmt::format_to(fmt::appender(text),
+                 "last message repeated {} times",
+                 m_repeated);
+  spdlog::details::log_msg summary(
+      spdlog::source_loc {},
+      m_last_logger_name,
+      m_last_level,
+      spdlog::string_view_t(text.data(), text.size()));
+  summary.time = m_last_time;
+  m_repeated = 0;
+  m_sink->log(summary);
+}
+
+}  // namespace Hert
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <spdlog/sinks/base_sink.h>
+
+namespace Hert
+{
+
+/**
+ * @brief 折叠连续重复记录的sink包装
+ *
+ * 与上一条输出的级别、调用点和完整文本都相同的记录只计数不输出，出现
+ * 不同的记录、窗口到期或sink销毁时补一条"last message repeated N
+ * times"，汇总沿用原记录的日志器名。窗口到期后的flush也会写出汇总，
+ * 定期刷新时重复停止后汇总的延迟不超过窗口加刷新间隔。日志风暴期间
+ * 每个窗口最多输出一条原始记录和一条汇总。
+ */
+class HertDedupSink final : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+  /**
+   * @param target 实际输出的sink，级别与格式仍由它自己控制
+   * @param window 折叠窗口，窗口内的重复记录合并为一条汇总
+   */
+  HertDedupSink(spdlog::sink_ptr target, std::chrono::milliseconds window);
+  ~HertDedupSink() override;
+
+  HertDedupSink(const HertDedupSink&) = delete;
+  HertDedupSink& operator=(const HertDedupSink&) = delete;
+  HertDedupSink(HertDedupSink&&) = delete;
+  HertDedupSink& operator=(HertDedupSink&&) = delete;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+  void flush_() override;
+  void set_pattern_(const std::string& pattern) override;
+  void set_formatter_(std::unique_ptr<spdlog::formatter> formatter) override;
+
+private:
+  bool same_source(const spdlog::source_loc& source) const;
+  void emit_repeated();
+
+  spdlog::sink_ptr m_sink;
+  std::chrono::milliseconds m_window;
+
+  std::string m_last_payload;  // 复用容量，稳态下不分配
+  std::string m_last_logger_name;
+  spdlog::level::level_enum m_last_level = spdlog::level::off;
+  spdlog::source_loc m_last_source;  // 只比较指针与行号，不解引用
+  spdlog::log_clock::time_point m_window_start;
+  spdlog::log_clock::time_point m_last_time;
+  std::uint64_t m_repeated = 0;
+};
+
+}  // namespace Hert
@@ -0,0 +1,75 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <streambuf>
+
+#include "HertLogDiagnostics.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#endif
+
+namespace Hert
+{
+
+namespace
+{
+std::atomic<int> g_diagnostics_fd {-1};
+
+// 不带缓冲区，每次输出直接写入，多线程同时写诊断时不共享状态
+class DiagnosticsBuf final : public std::streambuf
+{
+protected:
+  int_type overflow(int_type ch) override
+  {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+      return traits_type::not_eof(ch);
+    }
+    const char c = traits_type::to_char_type(ch);
+    return write_all(&c, 1) ? ch : traits_type::eof();
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override
+  {
+    return write_all(s, static_cast<std::size_t>(n)) ? n : 0;
+  }
+
+private:
+  static bool write_all(const char* data, std::size_t size)
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = g_diagnostics_fd.load(std::memory_order_acquire);
+    const int target = fd >= 0 ? fd : STDERR_FILENO;
+    while (size > 0) {
+      const ssize_t written = ::write(target, data, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      data += written;
+      size -= static_cast<std::size_t>(written);
+    }
+    return true;
+#else
+    // 没有fd捕获的平台上经stdio写标准错误，同样绕过cerr的重定向
+    return std::fwrite(data, 1, size, stderr) == size;
+#endif
+  }
+};
+}  // anonymous namespace
+
+std::ostream& detail::diagnostics()
+{
+  static DiagnosticsBuf buffer;
+  static std::ostream stream(&buffer);
+  return stream;
+}
+
+void detail::set_diagnostics_fd(int fd)
+{
+  g_diagnostics_fd.store(fd, std::memory_order_release);
+}
+
+}  // namespace Hert
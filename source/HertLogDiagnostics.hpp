@@ -0,0 +1,24 @@
+#pragma once
+
+#include <ostream>
+
+namespace Hert::detail
+{
+
+/**
+ * @brief 日志库自身的诊断输出，如sink异常与改名失败
+ *
+ * 直接写入诊断fd而不经std::cerr：标准流重定向或fd 2被捕获时，写进cerr
+ * 的诊断会回到日志自身，捕获管道写满时还会卡住写诊断的后台线程。
+ * 未设置诊断fd时写fd 2。每次输出单独写入，不做缓冲。
+ */
+std::ostream& diagnostics();
+
+/**
+ * @brief 设置诊断输出的fd，-1恢复为fd 2
+ *
+ * 调用方保证旧fd在仍可能写诊断的线程结束前有效。
+ */
+void set_diagnostics_fd(int fd);
+
+}  // namespace Hert::detail
@@ -0,0 +1,242 @@
+#include "HertLogFdCapture.hpp"
+
+#if HERT_HAS_FD_CAPTURE
+
+#  include <cerrno>
+#  include <cstring>
+#  include <vector>
+
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <unistd.h>
+
+#  include "HertLogBackend.hpp"
+#  include "HertLogDiagnostics.hpp"
+
+#  include <spdlog/common.h>
+
+namespace Hert
+{
+
+namespace
+{
+// 每次read的缓冲大小，一次取走管道中尽量多的数据
+constexpr std::size_t kReadChunk = 64UL * 1024UL;
+// 没有换行的输出积累到该长度时按一条记录输出
+constexpr std::size_t kMaxLineBytes = 64UL * 1024UL;
+#  ifdef F_SETPIPE_SZ
+// 扩大管道，读取线程短暂落后时写入方不必等待
+constexpr int kPipeBytes = 1024 * 1024;
+#  endif
+
+void set_flags(int fd, bool nonblocking)
+{
+  ::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+  if (nonblocking) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+}
+
+void close_fd(int& fd)
+{
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+}  // anonymous namespace
+
+HertLogFdCapture::HertLogFdCapture()
+{
+  const int console = ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+  if (console < 0) {
+    spdlog::throw_spdlog_ex("Failed duplicating stdout", errno);
+  }
+  m_console = ::fdopen(console, "w");
+  if (m_console == nullptr) {
+    const int error = errno;
+    ::close(console);
+    spdlog::throw_spdlog_ex("Failed opening console stream", error);
+  }
+  // 诊断输出写捕获前的标准错误，写不进管道也就不会回到日志
+  m_diagnostics = ::fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+  if (m_diagnostics >= 0) {
+    detail::set_diagnostics_fd(m_diagnostics);
+  }
+}
+
+HertLogFdCapture::~HertLogFdCapture()
+{
+  stop();
+  // 后端与各sink此时已经停止，不再写诊断输出
+  if (m_diagnostics >= 0) {
+    detail::set_diagnostics_fd(-1);
+    close_fd(m_diagnostics);
+  }
+  std::fclose(m_console);
+}
+
+void HertLogFdCapture::start()
+{
+  // 捕获前缓冲的输出仍写到原来的位置
+  std::fflush(stdout);
+  std::fflush(stderr);
+
+  if (::pipe(m_wake.data()) != 0) {
+    spdlog::throw_spdlog_ex("Failed creating capture pipe", errno);
+  }
+  set_flags(m_wake[0], true);
+  set_flags(m_wake[1], true);
+
+  for (Stream& stream : m_streams) {
+    std::array<int, 2> fds {};
+    if (::pipe(fds.data()) != 0) {
+      const int error = errno;
+      stop();
+      spdlog::throw_spdlog_ex("Failed creating capture pipe", error);
+    }
+    set_flags(fds[0], true);
+#  ifdef F_SETPIPE_SZ
+    ::fcntl(fds[1], F_SETPIPE_SZ, kPipeBytes);
+#  endif
+    stream.saved = ::fcntl(stream.target, F_DUPFD_CLOEXEC, 3);
+    if (stream.saved < 0 || ::dup2(fds[1], stream.target) < 0) {
+      const int error = errno;
+      ::close(fds[0]);
+      ::close(fds[1]);
+      close_fd(stream.saved);
+      stop();
+      spdlog::throw_spdlog_ex("Failed redirecting standard stream", error);
+    }
+    // 写端只保留在目标fd上，恢复目标fd后读取端即可读到结束
+    ::close(fds[1]);
+    stream.read_fd = fds[0];
+  }
+
+  m_stop.store(false);
+  m_reader = std::thread([this]() { run(); });
+}
+
+void HertLogFdCapture::stop()
+{
+  // 还原之前写进stdio缓冲的内容仍属于捕获期间
+  std::fflush(stdout);
+  std::fflush(stderr);
+  for (Stream& stream : m_streams) {
+    if (stream.saved >= 0) {
+      ::dup2(stream.saved, stream.target);
+      close_fd(stream.saved);
+    }
+  }
+
+  m_stop.store(true);
+  if (m_reader.joinable()) {
+    const char wake = 0;
+    [[maybe_unused]] const auto written = ::write(m_wake[1], &wake, 1);
+    m_reader.join();
+  }
+  for (Stream& stream : m_streams) {
+    close_fd(stream.read_fd);
+    stream.partial.clear();
+  }
+  close_fd(m_wake[0]);
+  close_fd(m_wake[1]);
+}
+
+void HertLogFdCapture::run()
+{
+  // 日志队列满时丢弃并计数，读取线程等待会让写stdout/stderr的线程
+  // 跟着卡在管道上
+  HertLogBackend::never_block_current_thread();
+  std::vector<char> buffer(kReadChunk);
+  for (;;) {
+    std::array<pollfd, 3> fds {};
+    for (std::size_t i = 0; i < m_streams.size(); ++i) {
+      fds[i] = pollfd {m_streams[i].read_fd, POLLIN, 0};  // 负数fd被忽略
+    }
+    fds[2] = pollfd {m_wake[0], POLLIN, 0};
+    if (::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+      return;
+    }
+
+    for (std::size_t i = 0; i < m_streams.size(); ++i) {
+      if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        read_available(m_streams[i], buffer.data(), buffer.size());
+      }
+    }
+
+    if (m_stop.load()) {
+      // 目标fd已还原，管道中剩下的就是捕获期间的全部输出
+      for (Stream& stream : m_streams) {
+        read_available(stream, buffer.data(), buffer.size());
+        if (!stream.partial.empty()) {
+          emit(stream, stream.partial);
+          stream.partial.clear();
+        }
+      }
+      return;
+    }
+  }
+}
+
+void HertLogFdCapture::read_available(Stream& stream,
+                                      char* buffer,
+                                      std::size_t size)
+{
+  while (stream.read_fd >= 0) {
+    const ssize_t count = ::read(stream.read_fd, buffer, size);
+    if (count > 0) {
+      consume(stream, buffer, static_cast<std::size_t>(count));
+      if (static_cast<std::size_t>(count) < size) {
+        return;  // 管道已读空，轮到另一个流
+      }
+    } else if (count == 0) {
+      close_fd(stream.read_fd);  // 所有写端都已关闭
+    } else if (errno != EINTR) {
+      return;
+    }
+  }
+}
+
+void HertLogFdCapture::consume(Stream& stream,
+                               const char* data,
+                               std::size_t size)
+{
+  const char* const end = data + size;
+  while (data < end) {
+    const auto* newline = static_cast<const char*>(
+        std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+    if (newline == nullptr) {
+      stream.partial.append(data, end);
+      if (stream.partial.size() >= kMaxLineBytes) {
+        emit(stream, stream.partial);
+        stream.partial.clear();
+      }
+      return;
+    }
+
+    const std::string_view line(data, static_cast<std::size_t>(newline - data));
+    if (stream.partial.empty()) {
+      emit(stream, line);  // 整行都在本次读取的数据里，不必拷贝
+    } else {
+      stream.partial.append(line);
+      emit(stream, stream.partial);
+      stream.partial.clear();
+    }
+    data = newline + 1;
+  }
+}
+
+void HertLogFdCapture::emit(const Stream& stream, std::string_view line)
+{
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  if (!line.empty()) {
+    HertLog::log_message_internal(stream.level, line);
+  }
+}
+
+}  // namespace Hert
+
+#endif  // HERT_HAS_FD_CAPTURE
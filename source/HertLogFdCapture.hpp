@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "Hert/HertLog.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#  define HERT_HAS_FD_CAPTURE 1
+#else
+#  define HERT_HAS_FD_CAPTURE 0
+#endif
+
+#if HERT_HAS_FD_CAPTURE
+
+namespace Hert
+{
+
+/**
+ * @brief 在文件描述符层面捕获标准输出与标准错误
+ *
+ * 把fd 1和2经dup2接到管道上，由专用线程大块读取、按换行切分后写入日志：
+ * stdout为INFO，stderr为ERROR。printf、fmt::print与直接写fd的C库都会被
+ * 捕获。控制台sink须改写console_file()，它指向捕获前的标准输出，否则
+ * 日志会经管道回到自己。
+ *
+ * 读取线程只做读取与入队，管道在Linux上扩到1MB。入队从不等待，日志队列
+ * 已满时丢弃并计入丢弃统计，写入方只在读取线程跟不上、管道写满时等待。
+ * 日志库自身的诊断输出改写捕获前的标准错误，不经管道回到日志。
+ */
+class HertLogFdCapture
+{
+public:
+  HertLogFdCapture();
+  ~HertLogFdCapture();
+
+  HertLogFdCapture(const HertLogFdCapture&) = delete;
+  HertLogFdCapture& operator=(const HertLogFdCapture&) = delete;
+  HertLogFdCapture(HertLogFdCapture&&) = delete;
+  HertLogFdCapture& operator=(HertLogFdCapture&&) = delete;
+
+  /**
+   * @brief 指向捕获前标准输出的流，由本对象关闭
+   */
+  std::FILE* console_file() const { return m_console; }
+
+  /**
+   * @brief 把fd 1和2接到管道并启动读取线程
+   */
+  void start();
+
+  /**
+   * @brief 恢复fd 1和2，写完管道中剩余的输出后结束读取线程
+   */
+  void stop();
+
+private:
+  struct Stream
+  {
+    int target;  // 被捕获的fd
+    LogLevel level;
+    int saved = -1;  // 捕获前的fd副本，stop时还原
+    int read_fd = -1;
+    std::string partial;  // 尚未遇到换行的半行
+  };
+
+  void run();
+  void read_available(Stream& stream, char* buffer, std::size_t size);
+  void consume(Stream& stream, const char* data, std::size_t size);
+  static void emit(const Stream& stream, std::string_view line);
+
+  std::array<Stream, 2> m_streams {Stream {1, LogLevel::INFO, -1, -1, {}},
+                                   Stream {2, LogLevel::ERROR, -1, -1, {}}};
+  std::FILE* m_console = nullptr;
+  int m_diagnostics = -1;  // 捕获前标准错误的副本，供诊断输出
+  std::array<int, 2> m_wake {-1, -1};  // stop通过它唤醒读取线程
+  std::atomic<bool> m_stop {false};
+  std::thread m_reader;
+};
+
+}  // namespace Hert
+
+#else
+
+namespace Hert
+{
+// 不支持的平台上只作为HertLog::s_fd_capture的完整类型，从不创建
+class HertLogFdCapture
+{
+};
+}  // namespace Hert
+
+#endif  // HERT_HAS_FD_CAPTURE
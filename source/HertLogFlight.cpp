@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "HertLogFlight.hpp"
+
+#include "Hert/HertLogBinary.hpp"
+#include "HertLogClock.hpp"
+
+#include <spdlog/details/os.h>
+
+#if defined(_WIN32)
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+namespace Hert
+{
+
+std::atomic<std::size_t> HertLogFlightRecorder::s_capacity {0};
+std::atomic<HertLogFlightRecorder::Ring*> HertLogFlightRecorder::s_rings {
+    nullptr};
+thread_local HertLogFlightRecorder::RingHandle HertLogFlightRecorder::t_ring;
+
+namespace
+{
+// 转储缓冲区，信号处理器中不能分配内存，也不宜占用太多栈
+constexpr std::size_t kDumpBufferSize = 64UL * 1024UL;
+char g_dump_buffer[kDumpBufferSize];
+std::atomic<bool> g_dumping {false};
+
+constexpr char kTextFormat[] = "{}";
+
+bool write_fd(int fd, const char* data, std::size_t size)
+{
+  while (size > 0) {
+#if defined(_WIN32)
+    const int count = ::_write(fd, data, static_cast<unsigned>(size));
+#else
+    const ssize_t count = ::write(fd, data, size);
+#endif
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += count;
+    size -= static_cast<std::size_t>(count);
+  }
+  return true;
+}
+
+// 只做拷贝与write的输出缓冲，攒满后整块写出
+class DumpWriter
+{
+public:
+  explicit DumpWriter(int fd)
+      : m_fd(fd)
+  {
+  }
+
+  void append(const char* data, std::size_t size)
+  {
+    if (size == 0) {
+      return;  // 空字符串可能是空指针
+    }
+    if (m_used + size > kDumpBufferSize) {
+      flush();
+      if (size > kDumpBufferSize) {
+        m_ok = m_ok && write_fd(m_fd, data, size);
+        return;
+      }
+    }
+    std::memcpy(g_dump_buffer + m_used, data, size);
+    m_used += size;
+  }
+
+  void byte(std::uint8_t value)
+  {
+    const char c = static_cast<char>(value);
+    append(&c, 1);
+  }
+
+  void varint(std::uint64_t value)
+  {
+    char bytes[10];
+    std::size_t size = 0;
+    while (value >= 0x80U) {
+      bytes[size++] = static_cast<char>((value & 0x7FU) | 0x80U);
+      value >>= 7U;
+    }
+    bytes[size++] = static_cast<char>(value);
+    append(bytes, size);
+  }
+
+  void string(const char* data, std::size_t size)
+  {
+    varint(size);
+    append(data, size);
+  }
+
+  void string(const char* text)
+  {
+    string(text, text ? std::strlen(text) : 0);
+  }
+
+  bool flush()
+  {
+    m_ok = m_ok && write_fd(m_fd, g_dump_buffer, m_used);
+    m_used = 0;
+    return m_ok;
+  }
+
+private:
+  int m_fd;
+  std::size_t m_used = 0;
+  bool m_ok = true;
+};
+}  // anonymous namespace
+
+HertLogFlightRecorder::RingHandle::~RingHandle()
+{
+  if (ring) {
+    // 缓冲区连同其中的记录留给之后的线程
+    ring->in_use.store(false, std::memory_order_release);
+  }
+}
+
+void HertLogFlightRecorder::configure(std::size_t records_per_thread)
+{
+  std::size_t expected = 0;
+  s_capacity.compare_exchange_strong(
+      expected, std::max<std::size_t>(records_per_thread, 1));
+}
+
+HertLogFlightRecorder::Ring* HertLogFlightRecorder::acquire_ring()
+{
+  for (Ring* ring = s_rings.load(std::memory_order_acquire); ring;
+       ring = ring->next)
+  {
+    bool expected = false;
+    if (!ring->in_use.load(std::memory_order_relaxed)
+        && ring->in_use.compare_exchange_strong(expected,
+                                                true,
+                                                std::memory_order_acquire))
+    {
+      return ring;
+    }
+  }
+
+  auto* ring = new Ring(s_capacity.load());
+  ring->in_use.store(true, std::memory_order_relaxed);
+  ring->next = s_rings.load(std::memory_order_relaxed);
+  while (!s_rings.compare_exchange_weak(
+      ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+  {
+  }
+  return ring;
+}
+
+void HertLogFlightRecorder::record(LogLevel level,
+                                   const LogSite* site,
+                                   const char* function,
+                                   const char* category,
+                                   const detail::DeferredCodec* codec,
+                                   fmt::string_view format,
+                                   const std::byte* args,
+                                   std::size_t args_size)
+{
+  Ring* ring = t_ring.ring;
+  if (ring == nullptr) {
+    ring = t_ring.ring = acquire_ring();
+  }
+
+  const std::uint64_t index = ring->written.load(std::memory_order_relaxed);
+  Slot& slot = ring->slots[index % ring->capacity];
+  // 先作废槽位再改写，转储时前后两次读到的序号一致才采用
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.time_ns = HertLogClock::system_ns();
+  slot.format = format.data();
+  slot.format_size = static_cast<std::uint32_t>(format.size());
+  slot.file = site ? site->file : nullptr;
+  slot.line = site ? static_cast<std::uint32_t>(site->line) : 0;
+  slot.function = function;
+  slot.category = category;
+  slot.thread_id =
+      static_cast<std::uint32_t>(spdlog::details::os::thread_id());
+  slot.level = level;
+  if (args_size <= detail::kFlightArgsSize) {
+    slot.codec = codec;
+    slot.args_size = static_cast<std::uint8_t>(args_size);
+    if (args_size > 0) {
+      std::memcpy(slot.args, args, args_size);
+    }
+  } else {
+    slot.codec = nullptr;
+    slot.args_size = 0;
+  }
+
+  slot.sequence.store(index + 1, std::memory_order_release);
+  ring->written.store(index + 1, std::memory_order_release);
+}
+
+void HertLogFlightRecorder::record_text(LogLevel level,
+                                        const char* category,
+                                        std::string_view message)
+{
+  using detail::DeferredStringArg;
+  constexpr std::size_t kMaxText =
+      detail::kFlightArgsSize - sizeof(std::uint32_t);
+  std::byte args[detail::kFlightArgsSize];
+  const std::string_view text = message.substr(0, kMaxText);
+  DeferredStringArg::encode(args, text);
+  record(level,
+         nullptr,
+         nullptr,
+         category,
+         &detail::deferred_codec<std::string_view>,
+         kTextFormat,
+         args,
+         DeferredStringArg::size(text));
+}
+
+std::size_t HertLogFlightRecorder::dump(int fd)
+{
+  if (g_dumping.exchange(true, std::memory_order_acquire)) {
+    return 0;  // 另一个线程正在转储，共用的缓冲区不可重入
+  }
+  const int saved_errno = errno;
+
+  DumpWriter out(fd);
+  out.append(binlog::kMagic, sizeof(binlog::kMagic));
+  out.byte(binlog::kVersion);
+
+  std::size_t count = 0;
+  std::int64_t last_time_ns = 0;
+  for (const Ring* ring = s_rings.load(std::memory_order_acquire); ring;
+       ring = ring->next)
+  {
+    const std::uint64_t written = ring->written.load(std::memory_order_acquire);
+    const std::uint64_t first =
+        written > ring->capacity ? written - ring->capacity : 0;
+    for (std::uint64_t index = first; index < written; ++index) {
+      const Slot& slot = ring->slots[index % ring->capacity];
+      if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+        continue;
+      }
+      const std::int64_t time_ns = slot.time_ns;
+      const char* format = slot.format;
+      const std::size_t format_size = slot.format_size;
+      const char* file = slot.file;
+      const std::uint32_t line = slot.line;
+      const char* function = slot.function;
+      const char* category = slot.category;
+      const detail::DeferredCodec* codec = slot.codec;
+      const std::uint32_t thread_id = slot.thread_id;
+      const LogLevel level = slot.level;
+      std::byte args[detail::kFlightArgsSize];
+      std::memcpy(args,
+                  slot.args,
+                  std::min<std::size_t>(slot.args_size, sizeof(args)));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != index + 1) {
+        continue;  // 读取期间被所属线程改写
+      }
+
+      // 每条记录一个调用点，转储时不建索引，避免分配内存
+      const auto site_id = static_cast<std::uint64_t>(count);
+      out.byte(static_cast<std::uint8_t>(binlog::RecordType::SITE));
+      out.varint(site_id);
+      out.string(category);
+      out.string(file);
+      out.varint(line);
+      out.string(function);
+      if (codec) {
+        out.string(format, format_size);
+      } else {
+        out.string(kTextFormat, sizeof(kTextFormat) - 1);
+      }
+
+      out.byte(static_cast<std::uint8_t>(binlog::RecordType::RECORD));
+      out.varint(site_id);
+      out.byte(static_cast<std::uint8_t>(level));
+      out.varint(detail::zigzag_encode(time_ns - last_time_ns));
+      out.varint(thread_id);
+      if (codec) {
+        // 参数区不超过kFlightArgsSize，序列化结果留在栈上缓冲区内
+        fmt::memory_buffer encoded;
+        codec->serialize(args, encoded);
+        out.append(encoded.data(), encoded.size());
+      } else {
+        // 参数已丢弃，以格式串原文作为消息
+        out.varint(1);
+        out.byte(static_cast<std::uint8_t>(detail::BinaryArgType::STRING));
+        out.string(format, format_size);
+      }
+      last_time_ns = time_ns;
+      ++count;
+    }
+  }
+  out.flush();
+
+  errno = saved_errno;
+  g_dumping.store(false, std::memory_order_release);
+  return count;
+}
+
+}  // namespace Hert
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "Hert/HertLog.hpp"
+
+namespace Hert
+{
+
+/**
+ * @brief 崩溃飞行记录器
+ *
+ * 每个线程持有一个固定容量的环形缓冲区，只由本线程写入，写入一条记录
+ * 只有取时间与几次拷贝，不加锁也不格式化。参数按延迟格式化的编码内联
+ * 在槽位中，格式串、文件名等只保存指针，因此须为静态存储；分类名
+ * 取自LogCategory::name()，已驻留到进程退出。
+ *
+ * 缓冲区登记在只追加的全局链表中且从不释放：线程退出后缓冲区留给新
+ * 线程复用，其中的记录在被覆盖前仍可转储。dump只调用write，可在信号
+ * 处理器中使用；每个槽位带序号，转储时正被改写的槽位会被跳过。
+ */
+class HertLogFlightRecorder
+{
+public:
+  /**
+   * @brief 设置每个线程的缓冲区容量，只有第一次调用生效
+   *
+   * 是否记录由HertLog::s_flight_recording控制，宏据此决定是否求值参数。
+   */
+  static void configure(std::size_t records_per_thread);
+
+  /**
+   * @brief 在调用线程的缓冲区中追加一条记录
+   *
+   * 参数区超过kFlightArgsSize时丢弃参数，转储时以格式串原文作为消息。
+   */
+  static void record(LogLevel level,
+                     const LogSite* site,
+                     const char* function,
+                     const char* category,
+                     const detail::DeferredCodec* codec,
+                     fmt::string_view format,
+                     const std::byte* args,
+                     std::size_t args_size);
+
+  /**
+   * @brief 追加一条运行时文本，超出参数区的部分被截断
+   */
+  static void record_text(LogLevel level,
+                          const char* category,
+                          std::string_view message);
+
+  /**
+   * @brief 以二进制日志格式写出所有缓冲区，返回写出的记录数
+   */
+  static std::size_t dump(int fd);
+
+private:
+  struct Slot
+  {
+    // 写完后为记录序号加1，改写期间为0
+    std::atomic<std::uint64_t> sequence {0};
+    std::int64_t time_ns = 0;
+    const char* format = nullptr;
+    const char* file = nullptr;
+    const char* function = nullptr;
+    const char* category = nullptr;
+    const detail::DeferredCodec* codec = nullptr;  // 为空时参数已丢弃
+    std::uint32_t format_size = 0;
+    std::uint32_t line = 0;
+    std::uint32_t thread_id = 0;
+    LogLevel level = LogLevel::TRACE;
+    std::uint8_t args_size = 0;
+    std::byte args[detail::kFlightArgsSize] {};
+  };
+  static_assert(sizeof(Slot) <= 128, "飞行记录器的槽位应保持紧凑");
+
+  struct Ring
+  {
+    explicit Ring(std::size_t size)
+        : slots(new Slot[size])
+        , capacity(size)
+    {
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    const std::size_t capacity;
+    std::atomic<std::uint64_t> written {0};  // 累计写入的记录数
+    std::atomic<bool> in_use {false};  // 是否被某个存活的线程持有
+    Ring* next = nullptr;  // 登记后不再修改
+  };
+
+  struct RingHandle
+  {
+    ~RingHandle();
+    Ring* ring = nullptr;
+  };
+
+  static Ring* acquire_ring();
+
+  static std::atomic<std::size_t> s_capacity;
+  static std::atomic<Ring*> s_rings;
+  static thread_local RingHandle t_ring;
+};
+
+}  // namespace Hert
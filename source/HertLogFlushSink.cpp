@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <utility>
+
+#include "HertLogFlushSink.hpp"
+
+namespace Hert
+{
+
+namespace
+{
+// 本线程刚处理的记录会触发flush_on的刷新
+thread_local bool t_auto_flush = false;
+}  // anonymous namespace
+
+HertFlushTicketSink::HertFlushTicketSink(std::size_t workers,
+                                         spdlog::level::level_enum flush_level)
+    : m_workers(std::max<std::size_t>(workers, 1))
+    , m_flush_level(flush_level)
+{
+  set_level(spdlog::level::trace);
+}
+
+void HertFlushTicketSink::log(const spdlog::details::log_msg& msg)
+{
+  t_auto_flush =
+      msg.level >= m_flush_level && msg.level != spdlog::level::off;
+}
+
+void HertFlushTicketSink::flush()
+{
+  if (std::exchange(t_auto_flush, false)) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_stale > 0) {
+    // 超时轮次的请求排在之后的请求前面，先把它们消耗掉
+    --m_stale;
+    return;
+  }
+  if (!m_active) {
+    return;  // 没有等待者的刷新，如关闭时投递的请求
+  }
+  const std::uint64_t round = m_round;
+  ++m_arrived;
+  m_cv.notify_all();
+  // 停在屏障处，保证同一轮的请求分别由不同的工作线程处理
+  m_cv.wait(lock, [this, round]() { return m_round != round; });
+}
+
+bool HertFlushTicketSink::flush_and_wait(spdlog::logger& logger,
+                                         std::chrono::milliseconds timeout)
+{
+  std::lock_guard<std::mutex> request(m_request_mutex);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active = true;
+    m_arrived = 0;
+  }
+  for (std::size_t i = 0; i < m_workers; ++i) {
+    logger.flush();
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const bool complete = m_cv.wait_for(
+      lock, timeout, [this]() { return m_arrived >= m_workers; });
+  m_stale += m_workers - std::min(m_arrived, m_workers);
+  m_active = false;
+  ++m_round;
+  lock.unlock();
+  m_cv.notify_all();
+  return complete;
+}
+
+bool HertFlushTicketSink::flush_logger(spdlog::logger& logger,
+                                       std::chrono::milliseconds timeout)
+{
+  for (const auto& sink : logger.sinks()) {
+    if (auto* ticket = dynamic_cast<HertFlushTicketSink*>(sink.get())) {
+      return ticket->flush_and_wait(logger, timeout);
+    }
+  }
+  logger.flush();
+  return true;
+}
+
+}  // namespace Hert
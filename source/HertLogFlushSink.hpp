@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <spdlog/logger.h>
+#include <spdlog/sinks/sink.h>
+
+namespace Hert
+{
+
+/**
+ * @brief 等待spdlog线程池写完并刷新此前记录的屏障sink
+ *
+ * 作为异步日志器的最后一个sink，不输出任何内容。flush_and_wait为线程池
+ * 的每个工作线程投递一次刷新请求；处理请求的工作线程先刷新前面的sink，
+ * 再在本sink的flush中等待，直到所有工作线程都到达。队列按先进先出出队，
+ * 所有工作线程都停在屏障处时，请求之前入队的记录都已写出并刷新。
+ *
+ * flush_on触发的逐条刷新紧跟在同一线程的log之后，据此与刷新请求区分。
+ */
+class HertFlushTicketSink final : public spdlog::sinks::sink
+{
+public:
+  /**
+   * @param workers 线程池的工作线程数
+   * @param flush_level 日志器flush_on的级别
+   */
+  HertFlushTicketSink(std::size_t workers,
+                      spdlog::level::level_enum flush_level);
+
+  void log(const spdlog::details::log_msg& msg) override;
+
+  /**
+   * @brief 由工作线程在处理刷新请求时调用
+   */
+  void flush() override;
+
+  void set_pattern(const std::string&) override {}
+  void set_formatter(std::unique_ptr<spdlog::formatter>) override {}
+
+  /**
+   * @brief 请求刷新并等待所有工作线程到达屏障
+   * @return 超时返回false，此时已写出的范围不确定
+   */
+  bool flush_and_wait(spdlog::logger& logger,
+                      std::chrono::milliseconds timeout);
+
+  /**
+   * @brief 在日志器的sink中查找屏障并等待；没有屏障的同步日志器直接刷新
+   */
+  static bool flush_logger(spdlog::logger& logger,
+                           std::chrono::milliseconds timeout);
+
+private:
+  const std::size_t m_workers;
+  const spdlog::level::level_enum m_flush_level;
+
+  std::mutex m_request_mutex;  // 同一时间只有一轮刷新
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_active = false;
+  std::size_t m_arrived = 0;
+  std::uint64_t m_round = 0;
+  std::size_t m_stale = 0;  // 超时的轮次中尚未到达的请求
+};
+
+}  // namespace Hert
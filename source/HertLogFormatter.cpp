@@ -0,0 +1,308 @@
+#include <array>
+#include <chrono>
+#include <ctime>
+#include <iterator>
+#include <string_view>
+
+#include "HertLogFormatter.hpp"
+
+#include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+#include <spdlog/pattern_formatter.h>
+
+namespace Hert
+{
+
+namespace
+{
+constexpr std::array<std::string_view, 7> kDayNames = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr std::array<std::string_view, 7> kFullDayNames = {"Sunday",
+                                                          "Monday",
+                                                          "Tuesday",
+                                                          "Wednesday",
+                                                          "Thursday",
+                                                          "Friday",
+                                                          "Saturday"};
+constexpr std::array<std::string_view, 12> kMonthNames = {"Jan",
+                                                          "Feb",
+                                                          "Mar",
+                                                          "Apr",
+                                                          "May",
+                                                          "Jun",
+                                                          "Jul",
+                                                          "Aug",
+                                                          "Sep",
+                                                          "Oct",
+                                                          "Nov",
+                                                          "Dec"};
+constexpr std::array<std::string_view, 12> kFullMonthNames = {"January",
+                                                              "February",
+                                                              "March",
+                                                              "April",
+                                                              "May",
+                                                              "June",
+                                                              "July",
+                                                              "August",
+                                                              "September",
+                                                              "October",
+                                                              "November",
+                                                              "December"};
+
+constexpr std::string_view kCachedFlags = "YymdHMSIpDTRaAbB";
+
+// 把value按固定宽度补零写入，value不超过宽度能表示的范围
+template<std::size_t Width>
+void append_fixed(std::uint32_t value, spdlog::memory_buf_t& dest)
+{
+  std::array<char, Width> digits {};
+  for (std::size_t i = Width; i > 0; --i) {
+    digits[i - 1] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  }
+  dest.append(digits.data(), digits.data() + Width);
+}
+
+void append_date_field(std::string& out, char flag, const std::tm& tm)
+{
+  auto it = std::back_inserter(out);
+  switch (flag) {
+    case 'Y':
+      fmt::format_to(it, "{:04}", tm.tm_year + 1900);
+      break;
+    case 'y':
+      fmt::format_to(it, "{:02}", tm.tm_year % 100);
+      break;
+    case 'm':
+      fmt::format_to(it, "{:02}", tm.tm_mon + 1);
+      break;
+    case 'd':
+      fmt::format_to(it, "{:02}", tm.tm_mday);
+      break;
+    case 'H':
+      fmt::format_to(it, "{:02}", tm.tm_hour);
+      break;
+    case 'M':
+      fmt::format_to(it, "{:02}", tm.tm_min);
+      break;
+    case 'S':
+      fmt::format_to(it, "{:02}", tm.tm_sec);
+      break;
+    case 'I':
+      fmt::format_to(it, "{:02}", tm.tm_hour % 12 == 0 ? 12 : tm.tm_hour % 12);
+      break;
+    case 'p':
+      out.append(tm.tm_hour >= 12 ? "PM" : "AM");
+      break;
+    case 'D':
+      fmt::format_to(it,
+                     "{:02}/{:02}/{:02}",
+                     tm.tm_mon + 1,
+                     tm.tm_mday,
+                     tm.tm_year % 100);
+      break;
+    case 'T':
+      fmt::format_to(
+          it, "{:02}:{:02}:{:02}", tm.tm_hour, tm.tm_min, tm.tm_sec);
+      break;
+    case 'R':
+      fmt::format_to(it, "{:02}:{:02}", tm.tm_hour, tm.tm_min);
+      break;
+    case 'a':
+      out.append(kDayNames[static_cast<std::size_t>(tm.tm_wday)]);
+      break;
+    case 'A':
+      out.append(kFullDayNames[static_cast<std::size_t>(tm.tm_wday)]);
+      break;
+    case 'b':
+      out.append(kMonthNames[static_cast<std::size_t>(tm.tm_mon)]);
+      break;
+    case 'B':
+      out.append(kFullMonthNames[static_cast<std::size_t>(tm.tm_mon)]);
+      break;
+    default:
+      break;
+  }
+}
+}  // anonymous namespace
+
+HertPatternFormatter::HertPatternFormatter(std::string pattern)
+    : m_pattern(std::move(pattern))
+{
+  if (!compile()) {
+    m_steps.clear();
+    m_segments.clear();
+    m_fallback = std::make_unique<spdlog::pattern_formatter>(m_pattern);
+  }
+  m_cached.resize(m_segments.size());
+}
+
+bool HertPatternFormatter::compile()
+{
+  std::vector<Piece>* segment = nullptr;  // 正在合并的缓存段
+  const auto cached_segment = [&]() -> std::vector<Piece>&
+  {
+    if (segment == nullptr) {
+      m_steps.push_back(Step {StepKind::CACHED, m_segments.size()});
+      segment = &m_segments.emplace_back();
+    }
+    return *segment;
+  };
+  const auto append_literal = [&](char c)
+  {
+    auto& pieces = cached_segment();
+    if (pieces.empty() || pieces.back().flag != 0) {
+      pieces.push_back(Piece {0, {}});
+    }
+    pieces.back().literal.push_back(c);
+  };
+  const auto add_step = [&](StepKind kind)
+  {
+    segment = nullptr;
+    m_steps.push_back(Step {kind, 0});
+  };
+
+  for (std::size_t i = 0; i < m_pattern.size(); ++i) {
+    const char c = m_pattern[i];
+    if (c != '%') {
+      append_literal(c);
+      continue;
+    }
+    if (++i == m_pattern.size()) {
+      return false;
+    }
+    const char flag = m_pattern[i];
+    if (kCachedFlags.find(flag) != std::string_view::npos) {
+      cached_segment().push_back(Piece {flag, {}});
+      continue;
+    }
+    switch (flag) {
+      case '%':
+        append_literal('%');
+        break;
+      case 'e':
+        add_step(StepKind::MILLIS);
+        break;
+      case 'f':
+        add_step(StepKind::MICROS);
+        break;
+      case 'F':
+        add_step(StepKind::NANOS);
+        break;
+      case 'l':
+        add_step(StepKind::LEVEL);
+        break;
+      case 'L':
+        add_step(StepKind::SHORT_LEVEL);
+        break;
+      case '^':
+        add_step(StepKind::COLOR_START);
+        break;
+      case '$':
+        add_step(StepKind::COLOR_END);
+        break;
+      case 'v':
+        add_step(StepKind::PAYLOAD);
+        break;
+      case 't':
+        add_step(StepKind::THREAD);
+        break;
+      case 'n':
+        add_step(StepKind::LOGGER);
+        break;
+      default:
+        return false;  // 对齐说明或不支持的标志
+    }
+  }
+  return true;
+}
+
+void HertPatternFormatter::render_cached(std::int64_t second)
+{
+  const std::tm tm =
+      spdlog::details::os::localtime(static_cast<std::time_t>(second));
+  for (std::size_t i = 0; i < m_segments.size(); ++i) {
+    std::string& text = m_cached[i];
+    text.clear();
+    for (const Piece& piece : m_segments[i]) {
+      if (piece.flag == 0) {
+        text.append(piece.literal);
+      } else {
+        append_date_field(text, piece.flag, tm);
+      }
+    }
+  }
+  m_cached_second = second;
+}
+
+void HertPatternFormatter::format(const spdlog::details::log_msg& msg,
+                                  spdlog::memory_buf_t& dest)
+{
+  namespace fmt_helper = spdlog::details::fmt_helper;
+  if (m_fallback) {
+    m_fallback->format(msg, dest);
+    return;
+  }
+
+  constexpr std::int64_t kNanosPerSecond = 1000000000;
+  const std::int64_t time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          msg.time.time_since_epoch())
+          .count();
+  const std::int64_t second = time_ns / kNanosPerSecond;
+  const auto fraction = static_cast<std::uint32_t>(time_ns % kNanosPerSecond);
+  if (second != m_cached_second) {
+    render_cached(second);
+  }
+
+  for (const Step& step : m_steps) {
+    switch (step.kind) {
+      case StepKind::CACHED: {
+        const std::string& text = m_cached[step.index];
+        dest.append(text.data(), text.data() + text.size());
+        break;
+      }
+      case StepKind::MILLIS:
+        append_fixed<3>(fraction / 1000000, dest);
+        break;
+      case StepKind::MICROS:
+        append_fixed<6>(fraction / 1000, dest);
+        break;
+      case StepKind::NANOS:
+        append_fixed<9>(fraction, dest);
+        break;
+      case StepKind::LEVEL:
+        fmt_helper::append_string_view(spdlog::level::to_string_view(msg.level),
+                                       dest);
+        break;
+      case StepKind::SHORT_LEVEL:
+        fmt_helper::append_string_view(
+            spdlog::level::to_short_c_str(msg.level), dest);
+        break;
+      case StepKind::COLOR_START:
+        msg.color_range_start = dest.size();
+        break;
+      case StepKind::COLOR_END:
+        msg.color_range_end = dest.size();
+        break;
+      case StepKind::PAYLOAD:
+        fmt_helper::append_string_view(msg.payload, dest);
+        break;
+      case StepKind::THREAD:
+        fmt_helper::append_int(msg.thread_id, dest);
+        break;
+      case StepKind::LOGGER:
+        fmt_helper::append_string_view(msg.logger_name, dest);
+        break;
+    }
+  }
+  fmt_helper::append_string_view(spdlog::details::os::default_eol, dest);
+}
+
+std::unique_ptr<spdlog::formatter> HertPatternFormatter::clone() const
+{
+  return std::make_unique<HertPatternFormatter>(m_pattern);
+}
+
+}  // namespace Hert
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/formatter.h>
+
+namespace Hert
+{
+
+/**
+ * @brief 预编译的日志格式器，兼容spdlog的常用格式标志
+ *
+ * 构造时把格式串编译为步骤序列：相邻的字面文本与只随秒变化的日期时间
+ * 字段合并为一段，每秒只渲染一次并缓存，之后每条记录只拷贝缓存再补上
+ * 毫秒等字段；级别名取自spdlog的静态表。格式串含不支持的标志或对齐
+ * 说明时整体交给spdlog::pattern_formatter处理。
+ *
+ * 支持的标志：%Y %y %m %d %H %M %S %I %p %D %T %R %a %A %b %B (按秒缓存)，
+ * %e %f %F %l %L %^ %$ %v %t %n %%。
+ */
+class HertPatternFormatter final : public spdlog::formatter
+{
+public:
+  explicit HertPatternFormatter(std::string pattern);
+
+  void format(const spdlog::details::log_msg& msg,
+              spdlog::memory_buf_t& dest) override;
+  std::unique_ptr<spdlog::formatter> clone() const override;
+
+private:
+  enum class StepKind : std::uint8_t
+  {
+    CACHED,  // 按秒缓存的一段，index为段号
+    MILLIS,
+    MICROS,
+    NANOS,
+    LEVEL,
+    SHORT_LEVEL,
+    COLOR_START,
+    COLOR_END,
+    PAYLOAD,
+    THREAD,
+    LOGGER,
+  };
+
+  struct Step
+  {
+    StepKind kind;
+    std::size_t index;
+  };
+
+  // 缓存段由字面文本与日期时间标志组成，flag为0时是字面文本
+  struct Piece
+  {
+    char flag;
+    std::string literal;
+  };
+
+  bool compile();
+  void render_cached(std::int64_t second);
+
+  std::string m_pattern;
+  std::vector<Step> m_steps;
+  std::vector<std::vector<Piece>> m_segments;
+  std::unique_ptr<spdlog::formatter> m_fallback;
+
+  std::int64_t m_cached_second = -1;
+  std::vector<std::string> m_cached;
+};
+
+}  // namespace Hert
@@ -0,0 +1,111 @@
+#include <array>
+#include <chrono>
+#include <ctime>
+
+#include "HertLogJsonWriter.hpp"
+
+#include "HertLogBackend.hpp"
+#include "HertLogDiagnostics.hpp"
+
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/os.h>
+
+namespace Hert
+{
+
+namespace
+{
+constexpr std::array<std::string_view, 7> kLevelNames = {
+    "trace", "debug", "info", "warn", "error", "critical", "off"};
+
+void append_int(fmt::memory_buffer& out, std::int64_t value)
+{
+  const fmt::format_int text(value);
+  out.append(text.data(), text.data() + text.size());
+}
+}  // anonymous namespace
+
+HertLogJsonWriter::HertLogJsonWriter(spdlog::sink_ptr sink, LogLevel level)
+    : m_sink(std::move(sink))
+    , m_level(level)
+{
+}
+
+void HertLogJsonWriter::append_time(std::int64_t time_ns)
+{
+  // UTC的ISO 8601时间，精确到微秒
+  constexpr std::int64_t kNanosPerSecond = 1000000000;
+  const std::int64_t second = time_ns / kNanosPerSecond;
+  if (second != m_cached_second) {
+    const std::tm tm =
+        spdlog::details::os::gmtime(static_cast<std::time_t>(second));
+    m_cached_time.clear();
+    fmt::format_to(fmt::appender(m_cached_time),
+                   "{:04}-{:02}-{:02}T{:02}:{:02}:{:02}",
+                   tm.tm_year + 1900,
+                   tm.tm_mon + 1,
+                   tm.tm_mday,
+                   tm.tm_hour,
+                   tm.tm_min,
+                   tm.tm_sec);
+    m_cached_second = second;
+  }
+  m_buffer.append(m_cached_time);
+  fmt::format_to(fmt::appender(m_buffer),
+                 ".{:06}Z",
+                 (time_ns % kNanosPerSecond) / 1000);
+}
+
+void HertLogJsonWriter::write(const LogRecordHeader& header,
+                              LogLevel level,
+                              std::string_view message,
+                              bool structured)
+{
+  m_buffer.clear();
+  m_buffer.append(std::string_view("{\"time\":\""));
+  append_time(header.time_ns);
+  m_buffer.append(std::string_view("\",\"level\":\""));
+  m_buffer.append(kLevelNames[static_cast<std::size_t>(level)]);
+  m_buffer.append(std::string_view("\",\"thread\":"));
+  append_int(m_buffer, static_cast<std::int64_t>(header.thread_id));
+  if (header.category != nullptr) {
+    m_buffer.append(std::string_view(",\"category\":"));
+    detail::append_json_string(m_buffer, header.category);
+  }
+  if (header.file != nullptr && header.line > 0 && header.function != nullptr)
+  {
+    m_buffer.append(std::string_view(",\"file\":"));
+    detail::append_json_string(m_buffer, header.basename);
+    m_buffer.append(std::string_view(",\"line\":"));
+    append_int(m_buffer, header.line);
+    m_buffer.append(std::string_view(",\"func\":"));
+    detail::append_json_string(m_buffer, header.function);
+  }
+  m_buffer.push_back(',');
+  if (structured) {
+    header.codec->json(reinterpret_cast<const std::byte*>(&header + 1),
+                       m_buffer);
+  } else {
+    m_buffer.append(std::string_view("\"msg\":"));
+    detail::append_json_string(m_buffer, message);
+  }
+  m_buffer.push_back('}');
+
+  spdlog::details::log_msg msg(
+      spdlog::source_loc {},
+      "",
+      HertLog::convert_log_level(level),
+      spdlog::string_view_t(m_buffer.data(), m_buffer.size()));
+  try {
+    m_sink->log(msg);
+  } catch (const std::exception& e) {
+    detail::diagnostics() << "Exception in JSON log sink: " << e.what() << '\n';
+  }
+}
+
+void HertLogJsonWriter::flush()
+{
+  m_sink->flush();
+}
+
+}  // namespace Hert
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "Hert/HertLog.hpp"
+
+#include <spdlog/sinks/sink.h>
+
+namespace Hert
+{
+
+struct LogRecordHeader;
+
+/**
+ * @brief JSON-lines日志写入器，只由后端线程写入
+ *
+ * 每条记录编码为一行JSON对象，直接在复用的缓冲区中拼接后交给文件sink
+ * 原样写出。结构化记录的字段由编解码函数从参数区写成独立的键，
+ * 其他记录只有"msg"一个文本字段。
+ */
+class HertLogJsonWriter
+{
+public:
+  /**
+   * @param sink 负责落盘与轮转的文件sink，格式须为"%v"
+   * @param level 写入的最低级别
+   */
+  HertLogJsonWriter(spdlog::sink_ptr sink, LogLevel level);
+
+  LogLevel level() const { return m_level; }
+
+  /**
+   * @brief 写入一条记录
+   * @param level 实际输出的级别，格式化失败时为ERROR
+   * @param message 已格式化的消息文本，不含位置前缀
+   * @param structured 是否由结构化记录的参数区生成字段
+   */
+  void write(const LogRecordHeader& header,
+             LogLevel level,
+             std::string_view message,
+             bool structured);
+
+  void flush();
+
+private:
+  void append_time(std::int64_t time_ns);
+
+  spdlog::sink_ptr m_sink;
+  LogLevel m_level;
+  fmt::memory_buffer m_buffer;
+  // 同一秒内的记录复用已格式化的日期时间部分
+  std::int64_t m_cached_second = -1;
+  fmt::memory_buffer m_cached_time;
+};
+
+}  // namespace Hert
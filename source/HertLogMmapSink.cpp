@@ -0,0 +1,304 @@
+#include "HertLogMmapSink.hpp"
+
+#if HERT_HAS_MMAP_SINK
+
+#  include <algorithm>
+#  include <cerrno>
+#  include <cstring>
+#  include <filesystem>
+#  include <utility>
+
+#  include "HertLogArchiver.hpp"
+#  include "HertLogDiagnostics.hpp"
+#  include "HertLogRotatingSink.hpp"
+
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+
+namespace Hert
+{
+
+namespace
+{
+std::size_t page_size()
+{
+  static const auto size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+int msync_flags(LogSyncPolicy policy)
+{
+  return policy == LogSyncPolicy::SYNC ? MS_SYNC : MS_ASYNC;
+}
+}  // anonymous namespace
+
+HertMmapFileSink::HertMmapFileSink(std::string path,
+                                   std::size_t segment_size,
+                                   std::size_t max_files,
+                                   LogRotationPeriod period,
+                                   LogSyncPolicy sync_policy,
+                                   std::size_t sync_bytes,
+                                   std::shared_ptr<HertLogArchiver> archiver)
+    : m_path(std::move(path))
+    , m_segment_size(std::max(
+          (segment_size + page_size() - 1) / page_size() * page_size(),
+          page_size()))
+    , m_max_files(max_files)
+    , m_period(period)
+    , m_sync_policy(sync_policy)
+    , m_sync_bytes(sync_bytes)
+    , m_archiver(std::move(archiver))
+{
+  std::filesystem::path log_path(m_path);
+  if (log_path.has_parent_path()) {
+    std::filesystem::create_directories(log_path.parent_path());
+  }
+  scan_existing();
+
+  m_current = create_segment(m_next_index++);
+  m_rotation_time = detail::next_rotation_time(
+      m_period, std::chrono::system_clock::now());
+  m_helper = std::thread([this]() { run_helper(); });
+}
+
+HertMmapFileSink::~HertMmapFileSink()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    m_stop = true;
+  }
+  m_helper_wakeup.notify_one();
+  if (m_helper.joinable()) {
+    m_helper.join();
+  }
+
+  for (auto& segment : m_retired) {
+    retire_segment(std::move(segment), true);
+  }
+  m_retired.clear();
+  trim_history();
+  if (m_next) {
+    retire_segment(std::move(m_next), false);  // 未使用的预分配分段
+  }
+  // 最后一个分段与运行期间的当前分段一样不计入max_files
+  if (m_current) {
+    retire_segment(std::move(m_current), true);
+  }
+}
+
+void HertMmapFileSink::scan_existing()
+{
+  // 接着目录中已有的最大序号继续编号，避免覆盖上次运行的日志
+  for (auto& [index, segment_path] : detail::list_log_segments(m_path)) {
+    m_next_index = index + 1;
+    if (!m_archiver) {
+      m_history.push_back(std::move(segment_path));
+    } else if (!segment_path.ends_with(".gz")) {
+      // 上次退出前没压缩完的分段
+      m_archiver->submit(std::move(segment_path), m_path, m_max_files);
+    }
+  }
+  trim_history();
+}
+
+std::unique_ptr<HertMmapFileSink::Segment> HertMmapFileSink::create_segment(
+    std::uint64_t index)
+{
+  auto segment = std::make_unique<Segment>();
+  segment->path = detail::log_segment_path(m_path, index);
+  segment->fd = ::open(
+      segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (segment->fd < 0) {
+    spdlog::throw_spdlog_ex("Failed opening log segment " + segment->path,
+                            errno);
+  }
+
+  const auto size = static_cast<off_t>(m_segment_size);
+#  ifdef __linux__
+  // 预先分配磁盘块，写入时不会再因扩展文件而分配空间
+  const int result = ::posix_fallocate(segment->fd, 0, size);
+  if (result != 0 && result != EOPNOTSUPP && result != EINVAL) {
+    ::close(segment->fd);
+    spdlog::throw_spdlog_ex("Failed allocating log segment " + segment->path,
+                            result);
+  }
+#  endif
+  if (::ftruncate(segment->fd, size) != 0) {
+    const int error = errno;
+    ::close(segment->fd);
+    spdlog::throw_spdlog_ex("Failed sizing log segment " + segment->path,
+                            error);
+  }
+
+  void* data = ::mmap(nullptr,
+                      m_segment_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      segment->fd,
+                      0);
+  if (data == MAP_FAILED) {
+    const int error = errno;
+    ::close(segment->fd);
+    spdlog::throw_spdlog_ex("Failed mapping log segment " + segment->path,
+                            error);
+  }
+  segment->data = static_cast<char*>(data);
+  return segment;
+}
+
+void HertMmapFileSink::sync_range(Segment& segment, int flags)
+{
+  // msync的起始地址必须按页对齐
+  const std::size_t start = segment.synced / page_size() * page_size();
+  if (segment.used > start) {
+    ::msync(segment.data + start, segment.used - start, flags);
+  }
+  segment.synced = segment.used;
+}
+
+void HertMmapFileSink::retire_segment(std::unique_ptr<Segment> segment,
+                                      bool keep)
+{
+  if (keep && m_sync_policy != LogSyncPolicy::NONE) {
+    sync_range(*segment, msync_flags(m_sync_policy));
+  }
+  ::munmap(segment->data, m_segment_size);
+  if (keep) {
+    // 去掉预分配但未写入的部分
+    if (::ftruncate(segment->fd, static_cast<off_t>(segment->used)) != 0) {
+      detail::diagnostics() << "Failed truncating log segment "
+                            << segment->path << '\n';
+    }
+  }
+  ::close(segment->fd);
+
+  if (!keep) {
+    std::error_code error;
+    std::filesystem::remove(segment->path, error);
+    return;
+  }
+
+  if (m_archiver) {
+    // 压缩器负责按max_files清理压缩包
+    m_archiver->submit(std::move(segment->path), m_path, m_max_files);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_helper_mutex);
+  m_history.push_back(std::move(segment->path));
+}
+
+void HertMmapFileSink::trim_history()
+{
+  std::lock_guard<std::mutex> lock(m_helper_mutex);
+  std::error_code error;
+  while (m_history.size() > m_max_files) {
+    std::filesystem::remove(m_history.front(), error);
+    m_history.pop_front();
+  }
+}
+
+void HertMmapFileSink::advance()
+{
+  std::unique_ptr<Segment> next;
+  std::uint64_t index = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    next = std::move(m_next);
+    if (!next) {
+      index = m_next_index++;
+    }
+  }
+  if (!next) {
+    // 辅助线程还没准备好，只能在写入线程上创建
+    next = create_segment(index);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    m_retired.push_back(std::move(m_current));
+  }
+  m_current = std::move(next);
+  m_helper_wakeup.notify_one();
+}
+
+void HertMmapFileSink::run_helper()
+{
+  std::unique_lock<std::mutex> lock(m_helper_mutex);
+  bool failed = false;  // 创建失败后等到下次切换分段再重试
+  for (;;) {
+    m_helper_wakeup.wait(lock,
+                         [&]()
+                         {
+                           return m_stop || !m_retired.empty()
+                               || (!m_next && !failed);
+                         });
+    if (m_stop) {
+      return;
+    }
+
+    auto retired = std::move(m_retired);
+    m_retired.clear();
+    if (!retired.empty()) {
+      failed = false;
+    }
+    const bool create = !m_next && !failed;
+    const std::uint64_t index = create ? m_next_index++ : 0;
+    lock.unlock();
+
+    for (auto& segment : retired) {
+      retire_segment(std::move(segment), true);
+    }
+    trim_history();
+
+    std::unique_ptr<Segment> next;
+    if (create) {
+      try {
+        next = create_segment(index);
+      } catch (const std::exception& e) {
+        // 写入线程切换分段时会自行创建
+        detail::diagnostics() << e.what() << '\n';
+        failed = true;
+      }
+    }
+
+    lock.lock();
+    if (next) {
+      m_next = std::move(next);
+    }
+  }
+}
+
+void HertMmapFileSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+  const std::size_t size = std::min(formatted.size(), m_segment_size);
+
+  if (msg.time >= m_rotation_time) {
+    if (m_current->used > 0) {
+      advance();
+    }
+    m_rotation_time = detail::next_rotation_time(m_period, msg.time);
+  }
+  if (m_current->used + size > m_segment_size) {
+    advance();
+  }
+  std::memcpy(m_current->data + m_current->used, formatted.data(), size);
+  m_current->used += size;
+
+  if (m_sync_bytes > 0 && m_current->used - m_current->synced >= m_sync_bytes)
+  {
+    sync_range(*m_current, MS_ASYNC);
+  }
+}
+
+void HertMmapFileSink::flush_()
+{
+  if (m_sync_policy != LogSyncPolicy::NONE) {
+    sync_range(*m_current, msync_flags(m_sync_policy));
+  }
+}
+
+}  // namespace Hert
+
+#endif  // HERT_HAS_MMAP_SINK
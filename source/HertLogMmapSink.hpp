@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+
+#include <spdlog/sinks/base_sink.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  define HERT_HAS_MMAP_SINK 1
+#else
+#  define HERT_HAS_MMAP_SINK 0
+#endif
+
+#if HERT_HAS_MMAP_SINK
+
+namespace Hert
+{
+
+class HertLogArchiver;
+
+/**
+ * @brief 预分配分段的内存映射文件sink
+ *
+ * 日志写入固定大小的分段文件hert.000001.log、hert.000002.log...，
+ * 每个分段预先分配磁盘空间并整体映射到内存，写一条记录只是一次memcpy。
+ * 辅助线程提前准备好下一个分段，并负责旧分段的截断、解除映射与按
+ * max_files清理，写入线程切换分段时只交换指针，不做重命名也不等待IO。
+ * 进程异常退出时当前分段末尾会留下未写入的零字节。
+ */
+class HertMmapFileSink final : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+  /**
+   * @param path 日志文件路径，分段序号插入在扩展名之前
+   * @param segment_size 单个分段的字节数，向上取整到页大小
+   * @param max_files 除当前分段外保留的历史分段数
+   * @param period 按时间切换分段的周期，与分段大小同时生效
+   * @param sync_policy flush时的msync策略
+   * @param sync_bytes 每写入多少字节发起一次异步msync，0表示不发起
+   * @param archiver 写满的分段交给它压缩，为空时不压缩
+   * @throws spdlog::spdlog_ex 分段文件创建失败
+   */
+  HertMmapFileSink(std::string path,
+                   std::size_t segment_size,
+                   std::size_t max_files,
+                   LogRotationPeriod period,
+                   LogSyncPolicy sync_policy,
+                   std::size_t sync_bytes,
+                   std::shared_ptr<HertLogArchiver> archiver = nullptr);
+  ~HertMmapFileSink() override;
+
+  HertMmapFileSink(const HertMmapFileSink&) = delete;
+  HertMmapFileSink& operator=(const HertMmapFileSink&) = delete;
+  HertMmapFileSink(HertMmapFileSink&&) = delete;
+  HertMmapFileSink& operator=(HertMmapFileSink&&) = delete;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+  void flush_() override;
+
+private:
+  struct Segment
+  {
+    int fd = -1;
+    char* data = nullptr;
+    std::size_t used = 0;
+    std::size_t synced = 0;  // 已发起msync的位置
+    std::string path;
+  };
+
+  std::unique_ptr<Segment> create_segment(std::uint64_t index);
+  void retire_segment(std::unique_ptr<Segment> segment, bool keep);
+  void trim_history();
+  void sync_range(Segment& segment, int flags);
+  void advance();
+  void run_helper();
+  void scan_existing();
+
+  std::string m_path;
+  std::size_t m_segment_size;
+  std::size_t m_max_files;
+  LogRotationPeriod m_period;
+  LogSyncPolicy m_sync_policy;
+  std::size_t m_sync_bytes;
+  std::shared_ptr<HertLogArchiver> m_archiver;
+
+  // 只在base_sink的锁内访问
+  std::unique_ptr<Segment> m_current;
+  std::chrono::system_clock::time_point m_rotation_time;
+
+  // 辅助线程的任务，由m_helper_mutex保护
+  std::mutex m_helper_mutex;
+  std::condition_variable m_helper_wakeup;
+  std::unique_ptr<Segment> m_next;
+  std::vector<std::unique_ptr<Segment>> m_retired;
+  std::deque<std::string> m_history;  // 已完成的分段，按创建顺序
+  std::uint64_t m_next_index = 1;
+  bool m_stop = false;
+  std::thread m_helper;
+};
+
+}  // namespace Hert
+
+#endif  // HERT_HAS_MMAP_SINK
@@ -0,0 +1,67 @@
+#include <cstring>
+#include <unordered_map>
+
+#include "HertLogQt.hpp"
+
+#include "HertLogCategory.hpp"
+
+namespace Hert::detail
+{
+
+const LogCategory& qt_category(const char* name)
+{
+  if (name == nullptr || *name == '\0') {
+    name = "default";
+  }
+  // Qt分类名通常是静态字符串，按指针缓存；指针被复用时名称不再相同
+  thread_local std::unordered_map<const char*, const LogCategory*> cache;
+  const auto found = cache.find(name);
+  if (found != cache.end() && std::strcmp(found->second->name(), name) == 0) {
+    return *found->second;
+  }
+  const LogCategory& category = LogCategoryRegistry::instance().named(name);
+  cache.insert_or_assign(name, &category);
+  return category;
+}
+
+void append_utf16(fmt::memory_buffer& out, std::u16string_view text)
+{
+  // 每个UTF-16单元最多编码为3个字节，代理对的两个单元共4个字节
+  const std::size_t start = out.size();
+  out.resize(start + text.size() * 3);
+  char* dest = out.data() + start;
+
+  const auto put = [&dest](char32_t value)
+  { *dest++ = static_cast<char>(value); };
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    char32_t code = text[i];
+    if (code < 0x80) {
+      put(code);
+      continue;
+    }
+    if (code < 0x800) {
+      put(0xC0 | (code >> 6));
+      put(0x80 | (code & 0x3F));
+      continue;
+    }
+    if (code >= 0xD800 && code <= 0xDFFF) {
+      const bool paired = code <= 0xDBFF && i + 1 < text.size()
+          && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF;
+      if (paired) {
+        code = 0x10000 + ((code - 0xD800) << 10) + (text[++i] - 0xDC00);
+        put(0xF0 | (code >> 18));
+        put(0x80 | ((code >> 12) & 0x3F));
+        put(0x80 | ((code >> 6) & 0x3F));
+        put(0x80 | (code & 0x3F));
+        continue;
+      }
+      code = 0xFFFD;
+    }
+    put(0xE0 | (code >> 12));
+    put(0x80 | ((code >> 6) & 0x3F));
+    put(0x80 | (code & 0x3F));
+  }
+  out.resize(static_cast<std::size_t>(dest - out.data()));
+}
+
+}  // namespace Hert::detail
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "Hert/HertLog.hpp"
+
+namespace Hert::detail
+{
+
+/**
+ * @brief Qt分类对应的Hert分类，名称与Qt分类相同，空名称对应"default"
+ *
+ * 每个线程按Qt分类名的指针缓存查找结果，命中时不访问注册表。
+ */
+const LogCategory& qt_category(const char* name);
+
+/**
+ * @brief 把UTF-16文本编码为UTF-8追加到out，不成对的代理项替换为U+FFFD
+ */
+void append_utf16(fmt::memory_buffer& out, std::u16string_view text);
+
+}  // namespace Hert::detail
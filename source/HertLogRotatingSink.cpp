@@ -0,0 +1,363 @@
+#include <ctime>
+#include <filesystem>
+
+#include "HertLogRotatingSink.hpp"
+
+#include "HertLogArchiver.hpp"
+#include "HertLogDiagnostics.hpp"
+
+#include <spdlog/details/os.h>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace Hert
+{
+
+namespace
+{
+// 预备文件创建失败后的重试间隔，期间继续写当前文件
+constexpr auto kRetryDelay = std::chrono::seconds(1);
+
+// 能否重命名仍在写入的文件，决定是否使用预先打开的预备文件
+#ifdef _WIN32
+constexpr bool kRenameOpenFile = false;
+#else
+constexpr bool kRenameOpenFile = true;
+#endif
+
+void remove_oldest(const std::string& path, std::size_t max_files)
+{
+  const auto segments = detail::list_log_segments(path);
+  std::error_code error;
+  for (std::size_t i = 0; i + max_files < segments.size(); ++i) {
+    std::filesystem::remove(segments[i].second, error);
+  }
+}
+}  // anonymous namespace
+
+void HertRotatingFileSink::LogFile::open(const std::string& path,
+                                         bool truncate,
+                                         LogSyncPolicy sync)
+{
+  helper.open(path, truncate);
+#ifndef _WIN32
+  if (sync != LogSyncPolicy::NONE) {
+    sync_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+#else
+  (void)sync;
+#endif
+}
+
+void HertRotatingFileSink::LogFile::close()
+{
+  helper.close();
+#ifndef _WIN32
+  if (sync_fd >= 0) {
+    ::close(sync_fd);
+    sync_fd = -1;
+  }
+#endif
+}
+
+void HertRotatingFileSink::LogFile::sync(LogSyncPolicy policy) const
+{
+#ifndef _WIN32
+  if (sync_fd < 0) {
+    return;
+  }
+#  ifdef __linux__
+  if (policy == LogSyncPolicy::ASYNC) {
+    // 只发起回写，与msync(MS_ASYNC)相当
+    ::sync_file_range(sync_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    return;
+  }
+  ::fdatasync(sync_fd);
+#  else
+  if (policy == LogSyncPolicy::SYNC) {
+    ::fsync(sync_fd);
+  }
+#  endif
+#else
+  (void)policy;
+#endif
+}
+
+std::chrono::system_clock::time_point detail::next_rotation_time(
+    LogRotationPeriod period, std::chrono::system_clock::time_point time)
+{
+  if (period == LogRotationPeriod::NONE) {
+    return std::chrono::system_clock::time_point::max();
+  }
+  std::tm tm =
+      spdlog::details::os::localtime(std::chrono::system_clock::to_time_t(time));
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  if (period == LogRotationPeriod::DAILY) {
+    tm.tm_hour = 0;
+    tm.tm_mday += 1;  // 由mktime归一化，跨夏令时也落在零点
+  } else {
+    tm.tm_hour += 1;
+  }
+  tm.tm_isdst = -1;
+  return std::chrono::system_clock::from_time_t(std::mktime(&tm));
+}
+
+HertRotatingFileSink::HertRotatingFileSink(
+    std::string path,
+    std::size_t max_size,
+    std::size_t max_files,
+    LogRotationPeriod period,
+    LogSyncPolicy sync,
+    std::shared_ptr<HertLogArchiver> archiver)
+    : m_path(std::move(path))
+    , m_next_path(m_path + ".next")
+    , m_max_size(max_size)
+    , m_max_files(max_files)
+    , m_period(period)
+    , m_sync(sync)
+    , m_archiver(std::move(archiver))
+{
+  std::filesystem::path log_path(m_path);
+  if (log_path.has_parent_path()) {
+    std::filesystem::create_directories(log_path.parent_path());
+  }
+
+  // 接着已有的最大序号编号
+  for (const auto& [index, segment] : detail::list_log_segments(m_path)) {
+    m_next_index = index + 1;
+  }
+  recover_pending();
+  if (m_archiver) {
+    // 上次退出前没压缩完的文件重新提交
+    for (auto& [index, segment] : detail::list_log_segments(m_path)) {
+      if (!segment.ends_with(".gz")) {
+        m_archiver->submit(std::move(segment), m_path, m_max_files);
+      }
+    }
+  } else {
+    remove_oldest(m_path, m_max_files);
+  }
+
+  m_file = std::make_unique<LogFile>();
+  m_file->open(m_path, false, m_sync);
+  m_current_size = m_file->helper.size();
+
+  // 已有内容按最后写入时间所在的周期计算，跨周期重启后第一条记录即轮转
+  auto last_write = std::chrono::system_clock::now();
+  std::error_code error;
+  const auto modified = std::filesystem::last_write_time(m_path, error);
+  if (m_current_size > 0 && !error) {
+    last_write = std::chrono::time_point_cast<
+        std::chrono::system_clock::duration>(
+        std::chrono::file_clock::to_sys(modified));
+  }
+  m_rotation_time = detail::next_rotation_time(m_period, last_write);
+
+  m_helper = std::thread([this]() { run_helper(); });
+}
+
+HertRotatingFileSink::~HertRotatingFileSink()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    m_stop = true;
+  }
+  m_helper_wakeup.notify_one();
+  if (m_helper.joinable()) {
+    m_helper.join();  // 辅助线程退出前完成所有待处理的轮转
+  }
+  if (m_next) {
+    m_next->close();
+    std::error_code error;
+    std::filesystem::remove(m_next_path, error);
+  }
+}
+
+void HertRotatingFileSink::recover_pending()
+{
+  // 上次在交换文件之后、重命名之前退出：预备文件里是最新的记录
+  std::error_code error;
+  if (!std::filesystem::exists(m_next_path, error)) {
+    return;
+  }
+  if (std::filesystem::file_size(m_next_path, error) == 0 || error) {
+    std::filesystem::remove(m_next_path, error);
+    return;
+  }
+  if (std::filesystem::exists(m_path, error)) {
+    std::filesystem::rename(
+        m_path, detail::log_segment_path(m_path, m_next_index++), error);
+  }
+  std::filesystem::rename(m_next_path, m_path, error);
+}
+
+void HertRotatingFileSink::sink_it_(const spdlog::details::log_msg& msg)
+{
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+
+  if (msg.time >= m_rotation_time) {
+    if (m_current_size > 0) {
+      rotate(msg.time);
+    } else {
+      m_rotation_time = detail::next_rotation_time(m_period, msg.time);
+    }
+  }
+  if (m_max_size > 0 && m_current_size > 0
+      && m_current_size + formatted.size() > m_max_size)
+  {
+    rotate(msg.time);
+  }
+  m_file->helper.write(formatted);
+  m_current_size += formatted.size();
+}
+
+void HertRotatingFileSink::flush_()
+{
+  m_file->helper.flush();
+  m_file->sync(m_sync);
+}
+
+void HertRotatingFileSink::rotate(std::chrono::system_clock::time_point now)
+{
+  if constexpr (!kRenameOpenFile) {
+    rotate_in_place(now);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_helper_mutex);
+  if (!m_next && m_open_failed) {
+    return;  // 预备文件暂时无法创建，继续写当前文件
+  }
+  // 预备文件通常早已就绪，只有轮转比辅助线程还快时才需要等待
+  m_next_ready.wait(lock, [this]() { return m_next || m_open_failed; });
+  if (!m_next) {
+    return;
+  }
+
+  m_jobs.push_back(
+      RotateJob {std::move(m_file),
+                 detail::log_segment_path(m_path, m_next_index++)});
+  m_file = std::move(m_next);
+  lock.unlock();
+  m_helper_wakeup.notify_one();
+
+  m_current_size = 0;
+  m_rotation_time = detail::next_rotation_time(m_period, now);
+}
+
+void HertRotatingFileSink::rotate_in_place(
+    std::chrono::system_clock::time_point now)
+{
+  m_file->helper.flush();
+  m_file->sync(m_sync);
+  m_file->close();
+
+  std::string rotated_path;
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    rotated_path = detail::log_segment_path(m_path, m_next_index++);
+  }
+  std::error_code error;
+  std::filesystem::rename(m_path, rotated_path, error);
+  // 重命名失败时接着追加到原文件，不丢记录
+  m_file->open(m_path, false, m_sync);
+  m_current_size = m_file->helper.size();
+  m_rotation_time = detail::next_rotation_time(m_period, now);
+  if (error) {
+    detail::diagnostics() << "Failed renaming " << m_path << ": "
+                          << error.message() << '\n';
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_helper_mutex);
+    m_jobs.push_back(RotateJob {nullptr, std::move(rotated_path)});
+  }
+  m_helper_wakeup.notify_one();
+}
+
+void HertRotatingFileSink::finish_rotation(RotateJob& job)
+{
+  if (job.file) {
+    // 换下的文件在这里补一次落盘，不占用写入线程
+    job.file->helper.flush();
+    job.file->sync(m_sync);
+    job.file->close();
+
+    std::error_code error;
+    std::filesystem::rename(m_path, job.rotated_path, error);
+    if (error) {
+      detail::diagnostics() << "Failed renaming " << m_path << ": "
+                            << error.message() << '\n';
+    }
+    // 写入线程已在写预备文件，无论上一步是否成功都要让它成为当前文件，
+    // 否则下一个预备文件会截断它
+    std::filesystem::rename(m_next_path, m_path, error);
+    if (error) {
+      detail::diagnostics() << "Failed renaming " << m_next_path << ": "
+                            << error.message() << '\n';
+    }
+  }
+
+  if (m_archiver) {
+    m_archiver->submit(job.rotated_path, m_path, m_max_files);
+  } else {
+    remove_oldest(m_path, m_max_files);
+  }
+}
+
+void HertRotatingFileSink::run_helper()
+{
+  std::unique_lock<std::mutex> lock(m_helper_mutex);
+  for (;;) {
+    m_helper_wakeup.wait(lock,
+                         [this]()
+                         {
+                           return m_stop || !m_jobs.empty()
+                               || (kRenameOpenFile && !m_next
+                                   && !m_open_failed);
+                         });
+    if (!m_jobs.empty()) {
+      RotateJob job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      lock.unlock();
+      finish_rotation(job);
+      lock.lock();
+      continue;
+    }
+    if (m_stop) {
+      return;
+    }
+
+    lock.unlock();
+    auto next = std::make_unique<LogFile>();
+    bool opened = true;
+    try {
+      next->open(m_next_path, true, m_sync);
+    } catch (const spdlog::spdlog_ex& e) {
+      detail::diagnostics() << e.what() << '\n';
+      opened = false;
+    }
+    lock.lock();
+
+    if (opened) {
+      m_next = std::move(next);
+    } else {
+      m_open_failed = true;
+    }
+    m_next_ready.notify_all();
+    if (!opened) {
+      m_helper_wakeup.wait_for(lock,
+                               kRetryDelay,
+                               [this]() { return m_stop || !m_jobs.empty(); });
+      m_open_failed = false;
+    }
+  }
+}
+
+}  // namespace Hert
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Hert/HertLog.hpp"
+
+#include <spdlog/details/file_helper.h>
+#include <spdlog/sinks/base_sink.h>
+
+namespace Hert
+{
+
+class HertLogArchiver;
+
+namespace detail
+{
+/**
+ * @brief time所在周期结束(下一次轮转)的时刻，按本地时间的整点或零点计算
+ */
+std::chrono::system_clock::time_point next_rotation_time(
+    LogRotationPeriod period, std::chrono::system_clock::time_point time);
+}  // namespace detail
+
+/**
+ * @brief 按大小与时间轮转、不阻塞写入的滚动文件sink
+ *
+ * 当前文件始终是配置的路径。辅助线程预先打开好"<路径>.next"，轮转时
+ * 写入线程只交换文件句柄，随后的写入直接进入预备文件；辅助线程再关闭
+ * 旧文件、把它重命名为带序号的hert.000001.log、把预备文件改名为当前
+ * 路径，然后压缩或按max_files清理并准备下一个预备文件。
+ *
+ * 交换句柄依赖POSIX对已打开文件重命名的语义。Windows上打开的文件不能
+ * 重命名，退回到在写入线程上关闭、重命名后重新打开，压缩与清理仍由
+ * 辅助线程完成。
+ */
+class HertRotatingFileSink final : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+  /**
+   * @param path 当前日志文件路径
+   * @param max_size 单个文件的最大字节数，0表示不按大小轮转
+   * @param max_files 保留的历史文件(或压缩包)数量
+   * @param period 按时间轮转的周期，与大小上限同时生效
+   * @param sync flush时是否等待数据落盘
+   * @param archiver 轮转出的文件交给它压缩，为空时不压缩
+   */
+  HertRotatingFileSink(std::string path,
+                       std::size_t max_size,
+                       std::size_t max_files,
+                       LogRotationPeriod period,
+                       LogSyncPolicy sync,
+                       std::shared_ptr<HertLogArchiver> archiver);
+  ~HertRotatingFileSink() override;
+
+  HertRotatingFileSink(const HertRotatingFileSink&) = delete;
+  HertRotatingFileSink& operator=(const HertRotatingFileSink&) = delete;
+  HertRotatingFileSink(HertRotatingFileSink&&) = delete;
+  HertRotatingFileSink& operator=(HertRotatingFileSink&&) = delete;
+
+protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override;
+  void flush_() override;
+
+private:
+  /**
+   * @brief 打开的日志文件
+   *
+   * file_helper不暴露文件描述符，需要落盘时按同一路径另开一个只读描述符，
+   * fdatasync作用于文件本身，与经由哪个描述符写入无关。
+   */
+  struct LogFile
+  {
+    LogFile() = default;
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+    LogFile(LogFile&&) = delete;
+    LogFile& operator=(LogFile&&) = delete;
+    ~LogFile() { close(); }
+
+    void open(const std::string& path, bool truncate, LogSyncPolicy sync);
+    void close();
+    void sync(LogSyncPolicy policy) const;
+
+    spdlog::details::file_helper helper;
+    int sync_fd = -1;
+  };
+  using FilePtr = std::unique_ptr<LogFile>;
+
+  struct RotateJob
+  {
+    FilePtr file;  // 已换下的文件，为空时已由写入线程关闭并重命名
+    std::string rotated_path;
+  };
+
+  void recover_pending();
+  void rotate(std::chrono::system_clock::time_point now);
+  void rotate_in_place(std::chrono::system_clock::time_point now);
+  void finish_rotation(RotateJob& job);
+  void run_helper();
+
+  std::string m_path;
+  std::string m_next_path;
+  std::size_t m_max_size;
+  std::size_t m_max_files;
+  LogRotationPeriod m_period;
+  LogSyncPolicy m_sync;
+  std::shared_ptr<HertLogArchiver> m_archiver;
+
+  // 只在base_sink的锁内访问
+  FilePtr m_file;
+  std::size_t m_current_size = 0;
+  std::chrono::system_clock::time_point m_rotation_time;
+
+  // 辅助线程的状态，由m_helper_mutex保护
+  std::mutex m_helper_mutex;
+  std::condition_variable m_helper_wakeup;
+  std::condition_variable m_next_ready;
+  FilePtr m_next;
+  std::deque<RotateJob> m_jobs;
+  std::uint64_t m_next_index = 1;
+  bool m_open_failed = false;
+  bool m_stop = false;
+  std::thread m_helper;
+};
+
+}  // namespace Hert
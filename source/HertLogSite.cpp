@@ -0,0 +1,106 @@
+#include "HertLogSite.hpp"
+
+namespace Hert
+{
+
+void detail::register_log_site(const LogSite& site,
+                               const char* format,
+                               std::atomic<LogSiteState>& state)
+{
+  LogSiteRegistry::instance().add(site, format, state);
+}
+
+bool detail::glob_match(std::string_view pattern, std::string_view text)
+{
+  // 回溯到最近一个"*"重新匹配，最坏O(m*n)
+  std::size_t p = 0;
+  std::size_t t = 0;
+  std::size_t star = std::string_view::npos;
+  std::size_t resume = 0;
+  while (t < text.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+      ++p;
+      ++t;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      resume = t;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      t = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+detail::LogSiteRegistry& detail::LogSiteRegistry::instance()
+{
+  // 调用点在静态初始化阶段登记，注册表须先于它们可用且保留到进程退出
+  static auto* registry = new LogSiteRegistry();
+  return *registry;
+}
+
+void detail::LogSiteRegistry::add(const LogSite& site,
+                                  const char* format,
+                                  std::atomic<LogSiteState>& state)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const Entry entry {&site, format, &state};
+  for (const auto& [pattern, rule_state] : m_rules) {
+    if (matches(entry, pattern)) {
+      state.store(rule_state, std::memory_order_relaxed);
+    }
+  }
+  m_sites.push_back(entry);
+}
+
+std::vector<LogSiteInfo> detail::LogSiteRegistry::list(
+    std::string_view pattern)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<LogSiteInfo> result;
+  for (const auto& entry : m_sites) {
+    if (matches(entry, pattern)) {
+      result.push_back(LogSiteInfo {entry.site->level,
+                                    entry.site->file,
+                                    entry.site->line,
+                                    entry.format,
+                                    entry.state->load()});
+    }
+  }
+  return result;
+}
+
+std::size_t detail::LogSiteRegistry::set_state(std::string_view pattern,
+                                               LogSiteState state)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // 相同模式的旧规则被新规则取代
+  std::erase_if(m_rules,
+                [pattern](const auto& rule) { return rule.first == pattern; });
+  m_rules.emplace_back(pattern, state);
+
+  std::size_t matched = 0;
+  for (const auto& entry : m_sites) {
+    if (matches(entry, pattern)) {
+      entry.state->store(state, std::memory_order_relaxed);
+      ++matched;
+    }
+  }
+  return matched;
+}
+
+bool detail::LogSiteRegistry::matches(const Entry& entry,
+                                      std::string_view pattern)
+{
+  const std::string line = ":" + std::to_string(entry.site->line);
+  return glob_match(pattern, entry.site->basename + line)
+      || glob_match(pattern, entry.site->file + line)
+      || glob_match(pattern, entry.format);
+}
+
+}  // namespace Hert
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+
+namespace Hert::detail
+{
+
+/**
+ * @brief 通配符匹配，"*"匹配任意长度，"?"匹配单个字符
+ */
+bool glob_match(std::string_view pattern, std::string_view text);
+
+/**
+ * @brief 所有HERT_LOG_*调用点的注册表
+ *
+ * 调用点在程序启动时登记，注册表只在列出与设置时加锁；设置只改写
+ * 各调用点的原子状态，写日志的线程从不访问注册表。
+ */
+class LogSiteRegistry
+{
+public:
+  static LogSiteRegistry& instance();
+
+  void add(const LogSite& site,
+           const char* format,
+           std::atomic<LogSiteState>& state);
+  std::vector<LogSiteInfo> list(std::string_view pattern);
+  std::size_t set_state(std::string_view pattern, LogSiteState state);
+
+private:
+  struct Entry
+  {
+    const LogSite* site;
+    const char* format;
+    std::atomic<LogSiteState>* state;
+  };
+
+  LogSiteRegistry() = default;
+
+  static bool matches(const Entry& entry, std::string_view pattern);
+
+  std::mutex m_mutex;
+  std::vector<Entry> m_sites;
+  // 按设置顺序保存的规则，后登记的调用点依次应用
+  std::vector<std::pair<std::string, LogSiteState>> m_rules;
+};
+
+}  // namespace Hert::detail
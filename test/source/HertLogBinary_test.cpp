@@ -0,0 +1,168 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Hert/HertLog.hpp"
+#include "Hert/HertLogBinary.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace Hert;
+
+// ========== HertLog 二进制日志测试 ==========
+
+namespace
+{
+std::vector<BinaryLogEntry> read_all(const std::string& path)
+{
+  std::vector<BinaryLogEntry> entries;
+  HertLogBinaryReader reader(path);
+  BinaryLogEntry entry;
+  while (reader.next(entry)) {
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+void remove_logs(const std::string& path)
+{
+  std::filesystem::remove(path);
+  std::filesystem::remove("test_hert_binary.1.hlog");
+  for (const auto& entry : std::filesystem::directory_iterator(".")) {
+    if (entry.path().filename().string().starts_with("test_hert_binary.0")) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+}
+}  // namespace
+
+TEST_CASE("HertLog二进制日志测试", "[HertLog][binary]")
+{
+  const std::string binary_file = "test_hert_binary.hlog";
+  remove_logs(binary_file);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.binary_enabled = true;
+  config.binary_path = binary_file;
+  config.binary_level = LogLevel::DEBUG;
+
+  SECTION("参数编码与解码")
+  {
+    HertLog::initialize(config);
+    HertLog::setLevel(LogLevel::TRACE);
+
+    const int line = __LINE__ + 1;  // 宏按首行报告行号
+    HERT_LOG_DEBUG(
+        "整数{} {} 浮点{} {} 字符{} 布尔{}", -42, 7U, 1.5, 0.1F, 'x', true);
+    HertLog::info("字符串{} {}", std::string("abc"), "def");
+    HertLog::trace("低于二进制级别");
+    for (int i = 0; i < 3; ++i) {
+      HERT_LOG_WARN("循环{}", i);
+    }
+    HertLog::shutdown();
+
+    const auto entries = read_all(binary_file);
+    // 第一条是初始化消息，最后一条是关闭消息
+    REQUIRE(entries.size() == 7);
+    REQUIRE(entries[0].message == "HertLog initialized successfully");
+    REQUIRE(entries[1].level == LogLevel::DEBUG);
+    REQUIRE(entries[1].message == "整数-42 7 浮点1.5 0.1 字符x 布尔true");
+    REQUIRE(entries[1].file == __FILE__);
+    REQUIRE(entries[1].line == line);
+    REQUIRE(entries[1].function == __FUNCTION__);
+    REQUIRE(entries[2].message == "字符串abc def");
+    REQUIRE(entries[2].line == 0);
+    REQUIRE(entries[3].message == "循环0");
+    REQUIRE(entries[5].message == "循环2");
+    REQUIRE(entries[5].level == LogLevel::WARN);
+    REQUIRE(entries[6].message == "Shutting down HertLog...");
+
+    for (size_t i = 1; i < entries.size(); ++i) {
+      REQUIRE(entries[i].time >= entries[i - 1].time);
+      REQUIRE(entries[i].thread_id == entries[0].thread_id);
+    }
+    const auto now = std::chrono::system_clock::now();
+    REQUIRE(now - entries[0].time < std::chrono::minutes(1));
+  }
+
+  SECTION("调用点只写一次")
+  {
+    HertLog::initialize(config);
+    for (int i = 0; i < 1000; ++i) {
+      HERT_LOG_INFO("重复的调用点 {}", i);
+    }
+    HertLog::shutdown();
+
+    // 每条记录只有编号、级别、时间差、线程ID和一个小整数
+    const auto size = std::filesystem::file_size(binary_file);
+    REQUIRE(size < 1000 * 24);
+    const auto entries = read_all(binary_file);
+    REQUIRE(entries.size() == 1002);
+    REQUIRE(entries[1000].message == "重复的调用点 999");
+  }
+
+  SECTION("追加写入与轮转")
+  {
+    HertLog::initialize(config);
+    HertLog::info("第一次会话");
+    HertLog::shutdown();
+    HertLog::initialize(config);
+    HertLog::info("第二次会话");
+    HertLog::shutdown();
+
+    auto entries = read_all(binary_file);
+    REQUIRE(entries.size() == 6);
+    REQUIRE(entries[1].message == "第一次会话");
+    REQUIRE(entries[4].message == "第二次会话");
+
+    config.max_file_size = 256;
+    config.max_files = 1;
+    HertLog::initialize(config);
+    for (int i = 0; i < 100; ++i) {
+      HertLog::info("轮转消息 {}", i);
+    }
+    HertLog::shutdown();
+
+    REQUIRE(std::filesystem::exists("test_hert_binary.1.hlog"));
+    REQUIRE(std::filesystem::file_size(binary_file) <= 256);
+    entries = read_all(binary_file);
+    REQUIRE_FALSE(entries.empty());
+    REQUIRE(entries.back().message == "Shutting down HertLog...");
+  }
+
+  SECTION("读取压缩归档")
+  {
+    config.max_file_size = 256;
+    config.max_files = 1;
+    config.compress_rotated = true;
+    HertLog::initialize(config);
+    for (int i = 0; i < 100; ++i) {
+      HertLog::info("归档消息 {}", i);
+    }
+    HertLog::shutdown();
+
+    std::vector<std::string> archives;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+      const auto name = entry.path().filename().string();
+      if (name.starts_with("test_hert_binary.0") && name.ends_with(".gz")) {
+        archives.push_back(name);
+      }
+    }
+    REQUIRE(archives.size() == 1);
+    const auto entries = read_all(archives.front());
+    REQUIRE_FALSE(entries.empty());
+    REQUIRE(entries.back().message.starts_with("归档消息"));
+  }
+
+  SECTION("非二进制日志文件")
+  {
+    std::ofstream(binary_file) << "plain text";
+    REQUIRE_THROWS(HertLogBinaryReader(binary_file));
+  }
+
+  remove_logs(binary_file);
+}
@@ -1,13 +1,24 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <regex>
 #include <sstream>
 #include <thread>
 
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 #include "Hert/HertLog.hpp"
+#include "Hert/HertLogBinary.hpp"
 
 #include <catch2/catch_session.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
 using namespace Hert;
 
@@ -174,6 +185,23 @@ TEST_CASE("HertLog自定义处理器测试", "[HertLog][handler]")
     HertLog::clearHandlers();
   }
 
+  SECTION("被替换与清除的处理器随快照释放")
+  {
+    auto first = std::make_shared<int>(1);
+    auto second = std::make_shared<int>(2);
+    const std::weak_ptr<int> first_alive = first;
+    const std::weak_ptr<int> second_alive = second;
+
+    HertLog::addRecordHandler([held = std::move(first)](const LogRecord&) {});
+    HertLog::addRecordHandler([held = std::move(second)](const LogRecord&) {});
+    HertLog::info("快照");
+    REQUIRE_FALSE(first_alive.expired());
+
+    HertLog::clearHandlers();
+    REQUIRE(first_alive.expired());
+    REQUIRE(second_alive.expired());
+  }
+
   HertLog::shutdown();
 }
 
@@ -211,6 +239,40 @@ TEST_CASE("HertLog多线程安全测试", "[HertLog][multithread]")
     REQUIRE(true);
   }
 
+  SECTION("关闭时仍有线程在写日志")
+  {
+    config.console_enabled = false;
+    config.per_thread_queues = GENERATE(false, true);
+    HertLog::shutdown();
+    HertLog::initialize(config);
+
+    std::atomic<bool> running {true};
+    std::atomic<int> started {0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back(
+          [&running, &started, i]()
+          {
+            started.fetch_add(1);
+            while (running.load()) {
+              HertLog::info("关闭期间的消息 {}", i);
+              HERT_LOG_WARN("关闭期间的消息 {}", i);
+              (void)HertLog::flush();
+            }
+          });
+    }
+    while (started.load() < 4) {
+      std::this_thread::yield();
+    }
+    // 后端销毁前等待已进入的调用离开，之后的调用直接返回
+    HertLog::shutdown();
+    REQUIRE_FALSE(HertLog::is_initialized());
+    running.store(false);
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
   HertLog::shutdown();
 }
 
@@ -267,6 +329,134 @@ TEST_CASE("HertLog标准输出重定向测试", "[HertLog][std_redirect]")
   HertLog::shutdown();
 }
 
+TEST_CASE("HertLog标准输出按线程分行测试", "[HertLog][std_redirect_lines]")
+{
+  const std::filesystem::path log_dir = "test_hert_std_lines";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+
+  constexpr int kThreads = 4;
+  constexpr int kLines = 200;
+  HertLog::initialize(config);
+  HertLog::setPattern("%v");
+  HertLog::enableStdRedirect();
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back(
+          [t]()
+          {
+            // 每行分多次写入，其他线程的片段不应插进来
+            for (int i = 0; i < kLines; ++i) {
+              std::cout << "cout-" << t << '-' << i << ":"
+                        << std::string(40, 'x') << "\n";
+            }
+          });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  std::cout << "多行\n输出" << std::flush;
+  // cerr默认unitbuf，重定向期间分多次写入的一行仍是一条记录
+  std::cerr << "cerr-" << 42 << ':' << "值" << '\n';
+  HertLog::disableStdRedirect();
+  REQUIRE((std::cerr.flags() & std::ios_base::unitbuf) != 0);
+  HertLog::shutdown();
+
+  std::ifstream file(log_dir / "hert.log");
+  const std::regex expected(R"(cout-(\d)-(\d+):x{40})");
+  std::vector<int> counts(kThreads, 0);
+  std::vector<std::string> others;
+  for (std::string line; std::getline(file, line);) {
+    std::smatch match;
+    if (std::regex_match(line, match, expected)) {
+      ++counts[static_cast<std::size_t>(std::stoi(match[1].str()))];
+    } else if (line.find("cout-") != std::string::npos
+               || line.find("x") != std::string::npos)
+    {
+      FAIL("交错的行: " << line);
+    } else {
+      others.push_back(line);
+    }
+  }
+  for (const int count : counts) {
+    REQUIRE(count == kLines);
+  }
+  REQUIRE(std::find(others.begin(), others.end(), "多行") != others.end());
+  REQUIRE(std::find(others.begin(), others.end(), "输出") != others.end());
+  REQUIRE(std::find(others.begin(), others.end(), "cerr-42:值") != others.end());
+
+  std::filesystem::remove_all(log_dir);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("HertLog文件描述符捕获测试", "[HertLog][fd_capture]")
+{
+  const std::filesystem::path log_dir = "test_hert_fd_capture";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.capture_std_fds = true;
+
+  HertLog::initialize(config);
+  std::printf("printf输出%d\n", 1);
+  fmt::print("fmt输出{}\n", 2);
+  std::fprintf(stderr, "stderr输出\r\n");
+  // stdout不是终端时全缓冲，先写出再与直接写fd的内容比较
+  std::fflush(stdout);
+  constexpr std::string_view kRaw = "直接写fd\n半行";
+  REQUIRE(::write(STDOUT_FILENO, kRaw.data(), kRaw.size())
+          == static_cast<ssize_t>(kRaw.size()));
+  // 日志库的诊断写捕获前的标准错误，不经管道回到日志
+  HertLog::addRecordHandler(
+      [](const LogRecord& record)
+      {
+        if (record.message == "处理器抛出") {
+          throw std::runtime_error("handler failure");
+        }
+      });
+  HertLog::warn("处理器抛出");
+  HertLog::shutdown();
+
+  std::ifstream file(log_dir / "hert.log");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    lines.push_back(line);
+  }
+  const auto contains = [&lines](std::string_view suffix)
+  {
+    return std::any_of(lines.begin(),
+                       lines.end(),
+                       [suffix](const std::string& line)
+                       { return line.ends_with(suffix); });
+  };
+  REQUIRE(contains("[info] printf输出1"));
+  REQUIRE(contains("[info] fmt输出2"));
+  REQUIRE(contains("[error] stderr输出"));
+  REQUIRE(contains("[info] 直接写fd"));
+  REQUIRE(contains("[info] 半行"));
+  REQUIRE(std::none_of(lines.begin(),
+                       lines.end(),
+                       [](const std::string& line)
+                       { return line.find("handler failure")
+                             != std::string::npos; }));
+
+  // 关闭后标准输出恢复原样
+  std::printf("捕获结束\n");
+  std::fflush(stdout);
+
+  std::filesystem::remove_all(log_dir);
+}
+#endif
+
 #ifdef QT_CORE_LIB
 TEST_CASE("HertLog Qt集成测试", "[HertLog][qt]")
 {
@@ -291,6 +481,46 @@ TEST_CASE("HertLog Qt集成测试", "[HertLog][qt]")
 
   HertLog::shutdown();
 }
+
+Q_LOGGING_CATEGORY(lcHertQtTest, "hert.qt_test")
+
+TEST_CASE("HertLog Qt分类映射测试", "[HertLog][qt_category]")
+{
+  const std::filesystem::path log_dir = "test_hert_qt_category";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_level = LogLevel::TRACE;
+  config.file_path = (log_dir / "hert.log").string();
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::DEBUG);
+  HertLog::enableQtLogRedirect();
+
+  // 分类级别关闭的消息在Qt侧即被过滤
+  HertLog::setCategoryLevel("hert.qt_test", LogLevel::WARN);
+  REQUIRE_FALSE(lcHertQtTest().isDebugEnabled());
+  qCDebug(lcHertQtTest) << "被分类过滤";
+  qCWarning(lcHertQtTest).noquote() << QStringLiteral("分类警告 😀");
+
+  HertLog::resetCategoryLevel("hert.qt_test");
+  REQUIRE(lcHertQtTest().isDebugEnabled());
+  qCDebug(lcHertQtTest).noquote() << "恢复后的调试";
+
+  HertLog::disableQtLogRedirect();
+  HertLog::shutdown();
+
+  std::ifstream file(log_dir / "hert.log");
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  REQUIRE(content.find("被分类过滤") == std::string::npos);
+  REQUIRE(content.find("[warning] [Qt] 分类警告 😀") != std::string::npos);
+  REQUIRE(content.find("[debug] [Qt] 恢复后的调试") != std::string::npos);
+
+  std::filesystem::remove_all(log_dir);
+}
 #endif
 
 TEST_CASE("HertLog错误处理测试", "[HertLog][error_handling]")
@@ -353,3 +583,1441 @@ TEST_CASE("HertLog模式设置测试", "[HertLog][pattern]")
 
   HertLog::shutdown();
 }
+
+TEST_CASE("HertLog延迟格式化测试", "[HertLog][deferred]")
+{
+  const std::string test_log_file = "test_hert_deferred.log";
+
+  if (std::filesystem::exists(test_log_file)) {
+    std::filesystem::remove(test_log_file);
+  }
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = test_log_file;
+  config.file_level = LogLevel::DEBUG;
+  config.deferred_formatting = true;
+
+  HertLog::initialize(config);
+
+  SECTION("后端格式化各类参数")
+  {
+    std::vector<std::string> captured_messages;
+    std::mutex captured_mutex;
+
+    // 处理器在后端线程调用，先排空初始化消息
+    HertLog::flush();
+    HertLog::addHandler(
+        [&captured_messages, &captured_mutex](LogLevel /*level*/,
+                                              const std::string& message,
+                                              const std::string& /*file*/,
+                                              int /*line*/,
+                                              const std::string& /*function*/)
+        {
+          std::lock_guard<std::mutex> lock(captured_mutex);
+          captured_messages.push_back(message);
+        });
+
+    const std::string owned = "owned";
+    const char* literal = "literal";
+    HertLog::info("整数={} 浮点={:.2f} 布尔={} 字符={}", 42, 3.14159, true, 'x');
+    HertLog::info("字符串: {} {} {}", owned, literal, std::string_view("view"));
+    HERT_LOG_WARN("带位置的延迟消息: {}", 7);
+    // 超出参数区容量的调用退回到调用线程格式化
+    HertLog::debug("长字符串: {}", std::string(1024, 'a'));
+
+    HertLog::flush();
+
+    std::ifstream file(test_log_file);
+    REQUIRE(file.is_open());
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    file.close();
+
+    REQUIRE(content.find("整数=42 浮点=3.14 布尔=true 字符=x")
+            != std::string::npos);
+    REQUIRE(content.find("字符串: owned literal view") != std::string::npos);
+    REQUIRE(content.find("HertLog_test.cpp") != std::string::npos);
+    REQUIRE(content.find("带位置的延迟消息: 7") != std::string::npos);
+    REQUIRE(content.find(std::string(1024, 'a')) != std::string::npos);
+
+    HertLog::clearHandlers();
+
+    std::lock_guard<std::mutex> lock(captured_mutex);
+    REQUIRE(captured_messages.size() == 4);
+    REQUIRE(captured_messages[2] == "带位置的延迟消息: 7");
+  }
+
+  SECTION("字符指针的{:p}在调用线程上格式化")
+  {
+    // 延迟时字符指针按字符串拷贝，后端无法再按指针格式化
+    const char* text = "pointee";
+    char buffer[] = "mutable";
+    HertLog::info("指针 {:p} {}", text, 1);
+    HERT_LOG_WARN("可写指针 {:>20p}", static_cast<char*>(buffer));
+    HertLog::info("字符串 {} {{p}}", text);
+    REQUIRE(HertLog::flush());
+
+    std::ifstream file(test_log_file);
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    REQUIRE(content.find(fmt::format("指针 {:p} 1", fmt::ptr(text)))
+            != std::string::npos);
+    REQUIRE(content.find(fmt::format(
+                "可写指针 {:>20p}", fmt::ptr(static_cast<char*>(buffer))))
+            != std::string::npos);
+    REQUIRE(content.find("字符串 pointee {p}") != std::string::npos);
+    REQUIRE(content.find("Log format error") == std::string::npos);
+  }
+
+  HertLog::shutdown();
+
+  if (std::filesystem::exists(test_log_file)) {
+    std::filesystem::remove(test_log_file);
+  }
+}
+
+TEST_CASE("HertLog每线程队列测试", "[HertLog][per_thread_queue]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.per_thread_queues = true;
+  config.queue_size = 64;  // 小队列，覆盖队列写满后等待的路径
+
+  HertLog::initialize(config);
+
+  SECTION("多线程写入按时间归并且不丢失")
+  {
+    const int num_threads = 8;
+    const int messages_per_thread = 500;
+    std::vector<std::vector<int>> received(num_threads);
+    std::mutex received_mutex;
+
+    HertLog::flush();
+    HertLog::addHandler(
+        [&received, &received_mutex](LogLevel /*level*/,
+                                      const std::string& message,
+                                      const std::string& /*file*/,
+                                      int /*line*/,
+                                      const std::string& /*function*/)
+        {
+          int thread_index = 0;
+          int sequence = 0;
+          if (std::sscanf(message.c_str(), "t%d-%d", &thread_index, &sequence)
+              == 2)
+          {
+            std::lock_guard<std::mutex> lock(received_mutex);
+            received[static_cast<size_t>(thread_index)].push_back(sequence);
+          }
+        });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back(
+          [i, messages_per_thread]()
+          {
+            for (int j = 0; j < messages_per_thread; ++j) {
+              HertLog::info("t{}-{}", i, j);
+            }
+          });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    HertLog::flush();
+    HertLog::clearHandlers();
+
+    std::lock_guard<std::mutex> lock(received_mutex);
+    for (const auto& sequences : received) {
+      REQUIRE(sequences.size() == static_cast<size_t>(messages_per_thread));
+      REQUIRE(std::is_sorted(sequences.begin(), sequences.end()));
+    }
+  }
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog宏惰性求值测试", "[HertLog][lazy]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+
+  HertLog::initialize(config);
+
+  SECTION("被过滤的宏不求值参数")
+  {
+    int evaluations = 0;
+    const auto expensive = [&evaluations]()
+    {
+      ++evaluations;
+      return std::string("expensive");
+    };
+
+    HertLog::setLevel(LogLevel::WARN);
+    HERT_LOG_TRACE("trace: {}", expensive());
+    HERT_LOG_DEBUG("debug: {}", expensive());
+    HERT_LOG_INFO("info: {}", expensive());
+    REQUIRE(evaluations == 0);
+
+    HERT_LOG_WARN("warn: {}", expensive());
+    REQUIRE(evaluations == 1);
+
+    HertLog::setLevel(LogLevel::TRACE);
+    REQUIRE_NOTHROW(HERT_LOG_TRACE("trace: {}", expensive()));
+    REQUIRE(evaluations == 2);
+  }
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog后台处理器测试", "[HertLog][handler_backend]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.handlers_on_backend = true;
+
+  HertLog::initialize(config);
+
+  SECTION("慢处理器不阻塞写日志的线程")
+  {
+    std::atomic<int> handled {0};
+    std::thread::id handler_thread;
+    std::mutex handler_mutex;
+
+    HertLog::flush();
+    HertLog::addHandler(
+        [&](LogLevel /*level*/,
+            const std::string& /*message*/,
+            const std::string& /*file*/,
+            int /*line*/,
+            const std::string& /*function*/)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          {
+            std::lock_guard<std::mutex> lock(handler_mutex);
+            handler_thread = std::this_thread::get_id();
+          }
+          ++handled;
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; ++i) {
+      HertLog::info("后台处理器消息{}", i);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(elapsed < std::chrono::milliseconds(100));
+
+    HertLog::flush();
+    HertLog::clearHandlers();
+
+    REQUIRE(handled.load() == 5);
+    std::lock_guard<std::mutex> lock(handler_mutex);
+    REQUIRE(handler_thread != std::this_thread::get_id());
+  }
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog结构化记录处理器测试", "[HertLog][record_handler]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.console_level = LogLevel::TRACE;
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::TRACE);
+
+  SECTION("按级别过滤并携带位置信息")
+  {
+    std::vector<std::string> warnings;
+    std::vector<int> lines;
+    int all_count = 0;
+
+    LogHandlerFilter filter;
+    filter.min_level = LogLevel::WARN;
+    HertLog::addRecordHandler(
+        [&](const LogRecord& record)
+        {
+          warnings.emplace_back(record.message);
+          lines.push_back(record.line);
+          REQUIRE(record.thread_id != 0);
+          REQUIRE(record.time.time_since_epoch().count() > 0);
+        },
+        filter);
+    HertLog::addRecordHandler([&](const LogRecord& /*record*/)
+                              { ++all_count; });
+
+    HertLog::debug("调试消息");
+    HertLog::info("普通消息");
+    HERT_LOG_WARN("警告消息{}", 1);
+    HertLog::error("错误消息");
+
+    HertLog::clearHandlers();
+
+    REQUIRE(all_count == 4);
+    REQUIRE(warnings == std::vector<std::string> {"警告消息1", "错误消息"});
+    REQUIRE(lines[0] > 0);
+    REQUIRE(lines[1] == 0);
+  }
+
+  SECTION("按分类前缀过滤")
+  {
+    LogHandlerFilter filter;
+    filter.category = "net";
+    int matched = 0;
+    HertLog::addRecordHandler([&](const LogRecord& /*record*/) { ++matched; },
+                              filter);
+
+    // 普通日志没有分类，不会投递给订阅了分类的处理器
+    HertLog::info("无分类消息");
+    REQUIRE(matched == 0);
+
+    HertLog::clearHandlers();
+  }
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog调用点信息测试", "[HertLog][log_site]")
+{
+  using Hert::detail::basename;
+  static_assert(std::string_view(basename("a/b/c.cpp")) == "c.cpp");
+  static_assert(std::string_view(basename("a\\b.cpp")) == "b.cpp");
+  static_assert(std::string_view(basename("c.cpp")) == "c.cpp");
+
+  const std::string test_log_file = "test_hert_site.log";
+  if (std::filesystem::exists(test_log_file)) {
+    std::filesystem::remove(test_log_file);
+  }
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = test_log_file;
+  config.file_level = LogLevel::TRACE;
+  config.deferred_formatting = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::TRACE);
+
+  std::string function;
+  std::string file;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        function = std::string(record.function);
+        file = std::string(record.file);
+      });
+
+  const int line = __LINE__ + 1;
+  HERT_LOG_INFO("调用点{}", 42);
+  HertLog::flush();
+  HertLog::clearHandlers();
+  HertLog::shutdown();
+
+  // 文件保留完整路径，函数名取自宏展开处而非生成调用点的lambda
+  REQUIRE(file == __FILE__);
+  REQUIRE(function == __FUNCTION__);
+
+  std::ifstream input(test_log_file);
+  std::string content((std::istreambuf_iterator<char>(input)),
+                      std::istreambuf_iterator<char>());
+  input.close();
+  REQUIRE(content.find(fmt::format(
+              "[HertLog_test.cpp:{}] [{}] 调用点42", line, __FUNCTION__))
+          != std::string::npos);
+
+  std::filesystem::remove(test_log_file);
+}
+
+TEST_CASE("HertLog内存映射文件测试", "[HertLog][mmap]")
+{
+  const std::filesystem::path log_dir = "test_hert_mmap";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_mmap = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.max_file_size = 4096;
+  config.max_files = 2;
+  config.file_sync = LogSyncPolicy::ASYNC;
+
+  const auto collect = [&]()
+  {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(log_dir)) {
+      files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+  };
+
+  HertLog::initialize(config);
+  const std::string padding(100, 'x');
+  for (int i = 0; i < 200; ++i) {
+    HertLog::info("分段消息{:03} {}", i, padding);
+  }
+  HertLog::flush();
+  HertLog::shutdown();
+
+  // 只保留当前分段和max_files个历史分段，且都截掉了预分配的空间
+  const auto files = collect();
+  REQUIRE(files.size() == 3);
+  REQUIRE(files.back().filename().string().starts_with("hert."));
+  std::string content;
+  for (const auto& file : files) {
+    REQUIRE(std::filesystem::file_size(file) <= 4096);
+    std::ifstream input(file);
+    content.append(std::istreambuf_iterator<char>(input),
+                   std::istreambuf_iterator<char>());
+  }
+  REQUIRE(content.find('\0') == std::string::npos);
+  REQUIRE(content.find("分段消息199") != std::string::npos);
+  REQUIRE(content.find("Shutting down HertLog...") != std::string::npos);
+
+  // 再次启动时接着已有分段的序号继续写
+  HertLog::initialize(config);
+  HertLog::shutdown();
+  const auto reopened = collect();
+  REQUIRE(reopened.size() == 3);
+  REQUIRE(reopened.back() > files.back());
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog轮转压缩测试", "[HertLog][compress]")
+{
+  const std::filesystem::path log_dir = "test_hert_compress";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.max_file_size = 2048;
+  config.max_files = 2;
+  config.compress_rotated = true;
+  config.file_mmap = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  const std::string padding(200, 'x');
+  for (int i = 0; i < 100; ++i) {
+    HertLog::info("压缩消息{:03} {}", i, padding);
+  }
+  // 关闭时等待压缩线程处理完所有轮转出的文件
+  HertLog::shutdown();
+
+  std::vector<std::filesystem::path> archives;
+  for (const auto& entry : std::filesystem::directory_iterator(log_dir)) {
+    const auto name = entry.path().filename().string();
+    REQUIRE_FALSE(name.ends_with(".tmp"));
+    if (name.ends_with(".gz")) {
+      archives.push_back(entry.path());
+    }
+  }
+  REQUIRE(archives.size() == 2);
+  for (const auto& archive : archives) {
+    std::ifstream input(archive, std::ios::binary);
+    unsigned char magic[2] = {};
+    input.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    REQUIRE(magic[0] == 0x1f);
+    REQUIRE(magic[1] == 0x8b);
+  }
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog滚动文件测试", "[HertLog][rotate]")
+{
+  const std::filesystem::path log_dir = "test_hert_rotate";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.max_file_size = 2048;
+  config.max_files = 2;
+  // 按天轮转与大小上限同时生效，测试期间只会按大小轮转
+  config.rotation_period = LogRotationPeriod::DAILY;
+
+  HertLog::initialize(config);
+  const std::string padding(200, 'x');
+  for (int i = 0; i < 100; ++i) {
+    HertLog::info("滚动消息{:03} {}", i, padding);
+  }
+  HertLog::shutdown();
+
+  std::vector<std::string> segments;
+  for (const auto& entry : std::filesystem::directory_iterator(log_dir)) {
+    const auto name = entry.path().filename().string();
+    REQUIRE_FALSE(name.ends_with(".next"));
+    if (name != "hert.log") {
+      segments.push_back(name);
+      REQUIRE(entry.file_size() <= config.max_file_size);
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+  REQUIRE(segments.size() == 2);
+  REQUIRE(segments.back().starts_with("hert.0000"));
+
+  // 最新的记录在当前文件中，且在上一个分段之后
+  std::ifstream current(log_dir / "hert.log");
+  const std::string content((std::istreambuf_iterator<char>(current)),
+                            std::istreambuf_iterator<char>());
+  REQUIRE(content.find("滚动消息099") != std::string::npos);
+  std::ifstream previous(log_dir / segments.back());
+  const std::string previous_content(
+      (std::istreambuf_iterator<char>(previous)),
+      std::istreambuf_iterator<char>());
+  REQUIRE(previous_content.find("滚动消息099") == std::string::npos);
+  REQUIRE_FALSE(previous_content.empty());
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog结构化日志测试", "[HertLog][fields]")
+{
+  const std::filesystem::path log_dir = "test_hert_fields";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.json_enabled = true;
+  config.json_path = (log_dir / "hert.jsonl").string();
+
+  HertLog::initialize(config);
+  const std::string user = "alice";
+  HertLog::log_fields(LogLevel::INFO,
+                      "用户登录",
+                      field("user", user),
+                      field("id", 42),
+                      field("ok", true),
+                      field("ratio", 0.5),
+                      field("note", "say \"hi\"\n"));
+  HertLog::log_fields(LogLevel::DEBUG, "无字段");
+  HERT_LOG_INFO("普通消息{}", 1);
+  HertLog::shutdown();
+
+  std::ifstream json_file(log_dir / "hert.jsonl");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(json_file, line);) {
+    lines.push_back(line);
+  }
+  const auto find_line = [&lines](std::string_view text)
+  {
+    return std::find_if(lines.begin(),
+                        lines.end(),
+                        [text](const std::string& line)
+                        { return line.find(text) != std::string::npos; });
+  };
+
+  const auto login = find_line("\"msg\":\"用户登录\"");
+  REQUIRE(login != lines.end());
+  REQUIRE(login->starts_with("{\"time\":\""));
+  REQUIRE(login->ends_with("}"));
+  REQUIRE(login->find("\"level\":\"info\"") != std::string::npos);
+  REQUIRE(login->find(",\"user\":\"alice\",\"id\":42,\"ok\":true,\"ratio\":0.5,"
+                      "\"note\":\"say \\\"hi\\\"\\n\"")
+          != std::string::npos);
+  REQUIRE(find_line("\"msg\":\"无字段\"}") != lines.end());
+
+  const auto plain = find_line("\"msg\":\"普通消息1\"");
+  REQUIRE(plain != lines.end());
+  REQUIRE(plain->find("\"file\":\"HertLog_test.cpp\"") != std::string::npos);
+
+  // 文本输出为logfmt风格，需要时给值加引号
+  std::ifstream text_file(log_dir / "hert.log");
+  const std::string text((std::istreambuf_iterator<char>(text_file)),
+                         std::istreambuf_iterator<char>());
+  REQUIRE(text.find("用户登录 user=alice id=42 ok=true ratio=0.5 "
+                    "note=\"say \\\"hi\\\"\\n\"")
+          != std::string::npos);
+
+  std::filesystem::remove_all(log_dir);
+}
+
+namespace
+{
+Hert::LogCategory g_net_category("net");
+Hert::LogCategory g_net_io_category("net.io");
+Hert::LogCategory g_ui_category("ui.paint");
+}  // anonymous namespace
+
+TEST_CASE("HertLog分类级别测试", "[HertLog][category]")
+{
+  // 未初始化时所有分类关闭
+  REQUIRE(g_net_io_category.level() == LogLevel::OFF);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.per_thread_queues = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::INFO);
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.push_back(std::string(record.category) + ":"
+                           + std::string(record.message));
+      },
+      LogHandlerFilter {LogLevel::TRACE, "net"});
+
+  // 未单独设置的分类跟随全局级别
+  REQUIRE(g_net_io_category.level() == LogLevel::INFO);
+  HERT_CLOG_DEBUG(g_net_io_category, "被过滤{}", 0);
+
+  // 设置父分类后子分类立即生效，其他分类不受影响
+  HertLog::setCategoryLevel("net", LogLevel::DEBUG);
+  REQUIRE(g_net_category.level() == LogLevel::DEBUG);
+  REQUIRE(g_net_io_category.level() == LogLevel::DEBUG);
+  REQUIRE(g_ui_category.level() == LogLevel::INFO);
+  HERT_CLOG_DEBUG(g_net_io_category, "调试{}", 1);
+  HERT_LOG_DEBUG("全局调试消息被过滤");
+
+  // 子分类自己的设置优先于父分类
+  HertLog::setCategoryLevel("net.io", LogLevel::WARN);
+  REQUIRE(g_net_io_category.level() == LogLevel::WARN);
+  HERT_CLOG_INFO(g_net_io_category, "被过滤{}", 2);
+  HERT_CLOG_INFO(g_net_category, "父分类{}", 3);
+
+  HertLog::resetCategoryLevel("net.io");
+  HertLog::resetCategoryLevel("net");
+  REQUIRE(g_net_io_category.level() == LogLevel::INFO);
+
+  // 全局级别变化传递到没有单独设置的分类
+  HertLog::setLevel(LogLevel::TRACE);
+  REQUIRE(g_net_io_category.level() == LogLevel::TRACE);
+  HertLog::setLevel(LogLevel::INFO);
+
+  HertLog::flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(messages.size() == 2);
+    REQUIRE(messages[0] == "net.io:调试1");
+    REQUIRE(messages[1] == "net:父分类3");
+  }
+
+  HertLog::shutdown();
+  REQUIRE(g_net_category.level() == LogLevel::OFF);
+}
+
+namespace
+{
+void log_site_debug(int value)
+{
+  HERT_LOG_DEBUG("调用点开关测试 {}", value);
+}
+
+void log_site_info(int value)
+{
+  HERT_LOG_INFO("调用点开关测试信息 {}", value);
+}
+}  // anonymous namespace
+
+TEST_CASE("HertLog调用点开关测试", "[HertLog][site_registry]")
+{
+  // 调用点在main之前已登记，不必先执行
+  const auto sites = HertLog::listSites("*调用点开关测试*");
+  REQUIRE(sites.size() == 3);
+  REQUIRE(std::string_view(sites[0].file).ends_with("HertLog_test.cpp"));
+  REQUIRE(sites[0].state == LogSiteState::DEFAULT);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.per_thread_queues = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::INFO);
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        if (record.message.starts_with("调用点开关测试")) {
+          std::lock_guard<std::mutex> lock(mutex);
+          messages.emplace_back(record.message);
+        }
+      });
+
+  int evaluated = 0;
+  const auto count = [&evaluated]() { return ++evaluated; };
+
+  log_site_debug(1);  // 低于全局级别
+  REQUIRE(HertLog::setSiteState("调用点开关测试 {}", LogSiteState::ENABLED)
+          == 1);
+  log_site_debug(2);
+
+  // 按文件名与行号关闭，参数不会被求值
+  const auto info_site = HertLog::listSites("调用点开关测试信息 {}");
+  REQUIRE(info_site.size() == 1);
+  const std::string location =
+      "HertLog_test.cpp:" + std::to_string(info_site[0].line);
+  REQUIRE(HertLog::setSiteState(location, LogSiteState::DISABLED) == 1);
+  log_site_info(3);
+  REQUIRE(HertLog::listSites(location)[0].state == LogSiteState::DISABLED);
+  HERT_LOG_INFO("调用点开关测试计数 {}", count());
+
+  HertLog::setSiteState("*调用点开关测试*", LogSiteState::DEFAULT);
+  log_site_debug(4);
+  log_site_info(5);
+
+  HertLog::flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(messages
+            == std::vector<std::string> {"调用点开关测试 2",
+                                         "调用点开关测试计数 1",
+                                         "调用点开关测试信息 5"});
+  }
+  REQUIRE(evaluated == 1);
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog限流宏测试", "[HertLog][rate_limit]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::INFO);
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(record.message);
+      });
+  const auto take = [&]()
+  {
+    HertLog::flush();
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::exchange(messages, {});
+  };
+
+  int evaluated = 0;
+  const auto count = [&evaluated]() { return ++evaluated; };
+
+  SECTION("每N次输出一次")
+  {
+    for (int i = 0; i < 7; ++i) {
+      HERT_LOG_EVERY_N(WARN, 3, "第{}次", i);
+    }
+    REQUIRE(take()
+            == std::vector<std::string> {"第0次",
+                                         "2 similar messages suppressed",
+                                         "第3次",
+                                         "2 similar messages suppressed",
+                                         "第6次"});
+  }
+
+  SECTION("只输出前N次，被抑制的调用不求值参数")
+  {
+    for (int i = 0; i < 5; ++i) {
+      HERT_LOG_FIRST_N(INFO, 2, "前N次{}", count());
+    }
+    REQUIRE(take() == std::vector<std::string> {"前N次1", "前N次2"});
+    REQUIRE(evaluated == 2);
+  }
+
+  SECTION("按时间间隔输出")
+  {
+    const auto log = [](int i)
+    { HERT_LOG_EVERY_MS(WARN, 50, "间隔{}", i); };
+    log(0);
+    log(1);
+    log(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    log(3);
+    REQUIRE(take()
+            == std::vector<std::string> {
+                "间隔0", "2 similar messages suppressed", "间隔3"});
+  }
+
+  SECTION("令牌桶")
+  {
+    // 突发3条，之后每秒至多1条
+    for (int i = 0; i < 10; ++i) {
+      HERT_LOG_RATE_LIMITED(WARN, 1.0, 3, "令牌{}", i);
+    }
+    REQUIRE(take() == std::vector<std::string> {"令牌0", "令牌1", "令牌2"});
+  }
+
+  SECTION("速率不大于0时只输出最初的突发量")
+  {
+    for (int i = 0; i < 5; ++i) {
+      HERT_LOG_RATE_LIMITED(WARN, 0.0, 2, "零速率{}", i);
+      HERT_LOG_RATE_LIMITED(WARN, -1.0, 1, "负速率{}", i);
+      HERT_LOG_RATE_LIMITED(WARN, 1e-300, 3, "极小速率{}", i);
+      HERT_LOG_RATE_LIMITED(
+          WARN, 0.0, std::numeric_limits<std::uint64_t>::max(), "大突发{}", i);
+    }
+    const auto admitted = take();
+    const auto counted = [&](std::string_view prefix)
+    {
+      return std::count_if(admitted.begin(),
+                           admitted.end(),
+                           [prefix](const std::string& message)
+                           { return message.starts_with(prefix); });
+    };
+    REQUIRE(counted("零速率") == 2);
+    REQUIRE(counted("负速率") == 1);
+    REQUIRE(counted("极小速率") == 3);
+    REQUIRE(counted("大突发") == 5);
+  }
+
+  SECTION("级别过滤的调用不消耗计数")
+  {
+    for (int i = 0; i < 3; ++i) {
+      HERT_LOG_EVERY_N(DEBUG, 2, "调试{}", count());
+    }
+    REQUIRE(take().empty());
+    REQUIRE(evaluated == 0);
+  }
+
+  HertLog::shutdown();
+}
+
+TEST_CASE("HertLog重复记录折叠测试", "[HertLog][dedup]")
+{
+  const std::filesystem::path log_dir = "test_hert_dedup";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.dedup_window_ms = 60000;
+  config.per_thread_queues = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  for (int i = 0; i < 100; ++i) {
+    HERT_LOG_WARN("对端连接断开 {}", 7);
+  }
+  HERT_LOG_WARN("对端连接断开 {}", 8);
+  // 文本相同但调用点不同的记录不折叠
+  HERT_LOG_WARN("对端连接断开 {}", 8);
+  HertLog::shutdown();
+
+  std::ifstream file(log_dir / "hert.log");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    if (line.find("对端连接断开") != std::string::npos
+        || line.find("repeated") != std::string::npos)
+    {
+      lines.push_back(line);
+    }
+  }
+  REQUIRE(lines.size() == 4);
+  REQUIRE(lines[0].ends_with("对端连接断开 7"));
+  REQUIRE(lines[1].ends_with("last message repeated 99 times"));
+  REQUIRE(lines[2].ends_with("对端连接断开 8"));
+  REQUIRE(lines[3].ends_with("对端连接断开 8"));
+
+  // 重复停止后，窗口到期的刷新写出汇总，不必等下一条记录
+  std::filesystem::remove_all(log_dir);
+  config.dedup_window_ms = 50;
+  HertLog::initialize(config);
+  for (int i = 0; i < 10; ++i) {
+    HERT_LOG_WARN("对端连接断开 {}", 9);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  REQUIRE(HertLog::flush());
+  {
+    std::ifstream pending(log_dir / "hert.log");
+    std::string content((std::istreambuf_iterator<char>(pending)),
+                        std::istreambuf_iterator<char>());
+    REQUIRE(content.find("last message repeated 9 times")
+            != std::string::npos);
+  }
+  HertLog::shutdown();
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog队列溢出策略测试", "[HertLog][overflow]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.queue_size = 32;  // 每线程队列取最小容量，几十条即满
+  config.handlers_on_backend = true;
+  config.drop_report_ms = 1;
+
+  SECTION("丢弃新记录")
+  {
+    config.overflow_policy = LogOverflowPolicy::DROP_NEWEST;
+  }
+  SECTION("覆盖旧记录")
+  {
+    config.overflow_policy = LogOverflowPolicy::OVERWRITE_OLDEST;
+  }
+  SECTION("限时等待")
+  {
+    config.overflow_timeout_ms = 1;
+  }
+
+  HertLog::initialize(config);
+  HertLog::flush();
+
+  // 处理器卡住后台线程，模拟写入停滞的磁盘
+  std::atomic<bool> stalled {true};
+  std::atomic<bool> entered {false};
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        entered.store(true);
+        while (stalled.load()) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(record.message);
+      });
+  HertLog::info("阻塞");
+  while (!entered.load()) {
+    std::this_thread::yield();
+  }
+
+  for (int i = 0; i < 200; ++i) {
+    HertLog::info("记录{}", i);
+  }
+  HertLog::error("错误");
+  stalled.store(false);
+  HertLog::flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  HertLog::flush();
+
+  const LogDropStats stats = HertLog::dropStats();
+  HertLog::shutdown();
+
+  const auto contains = [&](std::string_view text)
+  { return std::find(messages.begin(), messages.end(), text) != messages.end(); };
+  // ERROR走单独的通道，任何策略下都不丢弃
+  REQUIRE(contains("错误"));
+  REQUIRE(stats.total() > 0);
+  REQUIRE(std::any_of(messages.begin(),
+                      messages.end(),
+                      [](const std::string& message)
+                      { return message.find("lost to queue overflow")
+                            != std::string::npos; }));
+
+  if (config.overflow_policy == LogOverflowPolicy::DROP_NEWEST) {
+    REQUIRE(stats.dropped == stats.total());
+    REQUIRE(contains("记录0"));
+    REQUIRE_FALSE(contains("记录199"));
+  } else if (config.overflow_policy == LogOverflowPolicy::OVERWRITE_OLDEST) {
+    REQUIRE(stats.overwritten == stats.total());
+    REQUIRE_FALSE(contains("记录0"));
+    REQUIRE(contains("记录199"));
+  } else {
+    REQUIRE(stats.timed_out == stats.total());
+    REQUIRE(contains("记录0"));
+  }
+  REQUIRE(messages.size() + stats.total() >= 202);
+}
+
+TEST_CASE("HertLog自动降载测试", "[HertLog][shed]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.queue_size = 32;
+  config.handlers_on_backend = true;
+  config.shed_high_percent = 50;
+  config.shed_low_percent = 10;
+
+  HertLog::initialize(config);
+  HertLog::flush();
+
+  // 处理器拖慢后台线程，生产者很快填满队列
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(record.message);
+      });
+  const auto find = [&](std::string_view text)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::find_if(messages.begin(),
+                        messages.end(),
+                        [text](const std::string& message)
+                        { return message.starts_with(text); })
+        - messages.begin();
+  };
+  const auto size = [&]()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<std::ptrdiff_t>(messages.size());
+  };
+
+  for (int i = 0; i < 400; ++i) {
+    HertLog::info("记录{}", i);
+  }
+  HertLog::error("降载期间的错误");
+
+  // 压力消退并保持一段时间后恢复
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (find("Log load shedding off") == size()
+         && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  HertLog::info("恢复");
+  HertLog::flush();
+  HertLog::shutdown();
+
+  const auto on = find("Log load shedding on");
+  const auto off = find("Log load shedding off");
+  REQUIRE(on < size());
+  REQUIRE(on < off);
+  REQUIRE(off < size());
+  REQUIRE(find("记录0") < on);
+  REQUIRE(find("降载期间的错误") < size());
+  REQUIRE(find("恢复") > off);
+  REQUIRE(find("恢复") < size());
+  REQUIRE(std::count_if(messages.begin(),
+                        messages.end(),
+                        [](const std::string& message)
+                        { return message.starts_with("记录"); })
+          < 400);
+}
+
+TEST_CASE("HertLog空闲后不误降载测试", "[HertLog][shed]")
+{
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.handlers_on_backend = true;
+  config.shed_latency_ms = 100;
+
+  HertLog::initialize(config);
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  HertLog::addRecordHandler(
+      [&](const LogRecord& record)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(record.message);
+      });
+
+  // 每轮空闲超过阈值后再写入，空闲时间不应算作积压
+  constexpr int kRounds = 10;
+  constexpr int kPerRound = 50;
+  for (int round = 0; round < kRounds; ++round) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    for (int i = 0; i < kPerRound; ++i) {
+      HertLog::info("空闲后{}", i);
+    }
+  }
+  HertLog::flush();
+  HertLog::shutdown();
+
+  REQUIRE(std::none_of(messages.begin(),
+                       messages.end(),
+                       [](const std::string& message)
+                       { return message.starts_with("Log load shedding"); }));
+  REQUIRE(std::count_if(messages.begin(),
+                        messages.end(),
+                        [](const std::string& message)
+                        { return message.starts_with("空闲后"); })
+          == kRounds * kPerRound);
+}
+
+TEST_CASE("HertLog独立输出线程测试", "[HertLog][sink_workers]")
+{
+  const std::filesystem::path log_dir = "test_hert_sink_workers";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = true;
+  config.console_level = LogLevel::OFF;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.sink_workers = true;
+  config.per_thread_queues = GENERATE(false, true);
+
+  HertLog::initialize(config);
+  for (int i = 0; i < 1000; ++i) {
+    HertLog::info("独立输出{}", i);
+  }
+  // flush等待各输出线程写完并刷新，无需关闭即可读到全部记录
+  HertLog::flush();
+
+  std::size_t count = 0;
+  {
+    std::ifstream file(log_dir / "hert.log");
+    for (std::string line; std::getline(file, line);) {
+      if (line.find("独立输出") != std::string::npos) {
+        ++count;
+      }
+    }
+  }
+  REQUIRE(count == 1000);
+  REQUIRE(HertLog::dropStats().total() == 0);
+
+  HertLog::shutdown();
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog输出队列覆盖测试", "[HertLog][sink_workers]")
+{
+  const std::filesystem::path log_dir = "test_hert_sink_overwrite";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.sink_workers = true;
+  config.sink_queue_size = 4;  // 几条即满，每轮都会覆盖
+  config.file_overflow = LogOverflowPolicy::OVERWRITE_OLDEST;
+
+  HertLog::initialize(config);
+  // 每轮一条ERROR紧跟大量INFO，覆盖只能淘汰其后的INFO
+  constexpr int kRounds = 100;
+  for (int round = 0; round < kRounds; ++round) {
+    HertLog::error("关键{}", round);
+    for (int i = 0; i < 64; ++i) {
+      HertLog::info("普通{}", i);
+    }
+  }
+  HertLog::flush();
+  const LogDropStats stats = HertLog::dropStats();
+  HertLog::shutdown();
+
+  std::size_t errors = 0;
+  {
+    std::ifstream file(log_dir / "hert.log");
+    for (std::string line; std::getline(file, line);) {
+      if (line.find("关键") != std::string::npos) {
+        ++errors;
+      }
+    }
+  }
+  REQUIRE(errors == kRounds);
+  REQUIRE(stats.timed_out == 0);
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog合并刷新测试", "[HertLog][group_flush]")
+{
+  const std::filesystem::path log_dir = "test_hert_group_flush";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.file_sync = LogSyncPolicy::SYNC;
+  config.flush_latency_ms = 1000;
+
+  HertLog::initialize(config);
+  const auto count = [&](std::string_view text)
+  {
+    std::ifstream file(log_dir / "hert.log");
+    std::size_t lines = 0;
+    for (std::string line; std::getline(file, line);) {
+      if (line.find(text) != std::string::npos) {
+        ++lines;
+      }
+    }
+    return lines;
+  };
+
+  SECTION("窗口内的错误合并为一次刷新，不晚于延迟上限")
+  {
+    for (int i = 0; i < 10; ++i) {
+      HertLog::error("突发错误{}", i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE(count("突发错误") == 0);
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (count("突发错误") < 10
+           && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    REQUIRE(count("突发错误") == 10);
+  }
+
+  SECTION("显式flush等待写出")
+  {
+    HertLog::warn("立即可见");
+    REQUIRE(HertLog::flush());
+    REQUIRE(count("立即可见") == 1);
+  }
+
+  HertLog::shutdown();
+  std::filesystem::remove_all(log_dir);
+
+  SECTION("线程池的多个工作线程都写完后flush才返回")
+  {
+    LogSinkConfig pool_config;
+    pool_config.console_enabled = false;
+    pool_config.file_enabled = true;
+    pool_config.file_path = (log_dir / "hert.log").string();
+    pool_config.backend_threads = 3;
+    pool_config.flush_level = LogLevel::WARN;
+
+    HertLog::initialize(pool_config);
+    for (int round = 0; round < 5; ++round) {
+      for (int i = 0; i < 200; ++i) {
+        if (i % 50 == 0) {
+          HertLog::warn("线程池刷新 {} {}", round, i);
+        } else {
+          HertLog::info("线程池刷新 {} {}", round, i);
+        }
+      }
+      REQUIRE(HertLog::flush());
+      const auto expected = static_cast<std::size_t>(200 * (round + 1));
+      REQUIRE(count("线程池刷新") == expected);
+    }
+    HertLog::shutdown();
+    std::filesystem::remove_all(log_dir);
+  }
+}
+
+TEST_CASE("HertLog预编译格式器测试", "[HertLog][formatter]")
+{
+  const std::filesystem::path log_dir = "test_hert_formatter";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+
+  const auto [pattern, expected] = GENERATE(
+      std::pair<std::string, std::string> {
+          "[%Y-%m-%d %H:%M:%S.%e] [%l] %v",
+          R"(\[\d{4}-\d\d-\d\d \d\d:\d\d:\d\d\.\d{3}\] \[warning\] 格式\d)"},
+      std::pair<std::string, std::string> {
+          "%D %T.%f %L [%n] %% %v",
+          R"(\d\d/\d\d/\d\d \d\d:\d\d:\d\d\.\d{6} W \[hert_logger\] % 格式\d)"},
+      // 对齐说明由spdlog的格式器处理
+      std::pair<std::string, std::string> {"%-8l|%v", R"(warning \|格式\d)"});
+
+  HertLog::initialize(config);
+  HertLog::setPattern(pattern);
+  for (int i = 0; i < 3; ++i) {
+    HertLog::warn("格式{}", i);
+  }
+  HertLog::shutdown();
+
+  std::ifstream file(log_dir / "hert.log");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) {
+    if (line.find("格式") != std::string::npos) {
+      lines.push_back(line);
+    }
+  }
+  REQUIRE(lines.size() == 3);
+  for (const auto& line : lines) {
+    INFO(line);
+    REQUIRE(std::regex_match(line, std::regex(expected)));
+  }
+
+  std::filesystem::remove_all(log_dir);
+}
+
+TEST_CASE("HertLog TSC时钟测试", "[HertLog][tsc_clock]")
+{
+  const std::filesystem::path log_dir = "test_hert_tsc_clock";
+  std::filesystem::remove_all(log_dir);
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = true;
+  config.file_path = (log_dir / "hert.log").string();
+  config.clock_source = LogClockSource::TSC;  // 不支持时退回system_clock
+
+  const auto wall_time = [](std::chrono::system_clock::time_point time)
+  {
+    const std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::ostringstream text;
+    text << std::put_time(std::localtime(&seconds), "%Y-%m-%d %H:%M:%S");
+    return text.str();
+  };
+  const std::string earliest =
+      wall_time(std::chrono::system_clock::now() - std::chrono::seconds(1));
+
+  constexpr int kThreads = 3;
+  constexpr int kRecords = 300;
+  HertLog::initialize(config);
+  HertLog::setPattern("%Y-%m-%d %H:%M:%S.%F|%v");
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back(
+          [t]()
+          {
+            for (int i = 0; i < kRecords; ++i) {
+              HertLog::info("tsc {} {}", t, i);
+              if (i % 100 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+              }
+            }
+          });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  HertLog::shutdown();
+  const std::string latest =
+      wall_time(std::chrono::system_clock::now() + std::chrono::seconds(1));
+
+  // 换算后的时间与系统时间一致，每个线程的时间戳单调不减
+  std::ifstream file(log_dir / "hert.log");
+  std::vector<std::string> last_time(kThreads);
+  std::vector<int> counts(kThreads, 0);
+  const std::regex record(R"((.+)\|tsc (\d) (\d+))");
+  for (std::string line; std::getline(file, line);) {
+    std::smatch match;
+    if (!std::regex_match(line, match, record)) {
+      continue;
+    }
+    const std::string time = match[1].str();
+    const auto thread = static_cast<std::size_t>(std::stoi(match[2].str()));
+    INFO(line);
+    REQUIRE(time >= earliest);
+    REQUIRE(time <= latest);
+    REQUIRE(time >= last_time[thread]);
+    last_time[thread] = time;
+    ++counts[thread];
+  }
+  for (const int count : counts) {
+    REQUIRE(count == kRecords);
+  }
+
+  std::filesystem::remove_all(log_dir);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("HertLog飞行记录器测试", "[HertLog][flight]")
+{
+  const auto dump_dir =
+      std::filesystem::temp_directory_path() / "hert_flight_test";
+  std::filesystem::remove_all(dump_dir);
+  std::filesystem::create_directories(dump_dir);
+  const std::string dump_path = (dump_dir / "flight.hlog").string();
+
+  LogSinkConfig config;
+  config.console_enabled = false;
+  config.file_enabled = false;
+  config.deferred_formatting = true;
+
+  HertLog::enableFlightRecorder(64);
+  HertLog::initialize(config);
+  HertLog::setLevel(LogLevel::INFO);
+
+  // 每个线程只保留最近的64条
+  for (int i = 0; i < 100; ++i) {
+    HERT_LOG_TRACE("飞行记录循环 {}", i);
+  }
+  // 被级别过滤的调用也进入记录器，超出参数区的调用只保留格式串
+  HERT_LOG_TRACE("飞行记录 {} {}", 42, "trace");
+  HERT_LOG_INFO("飞行记录 {}", 3.5);
+  HertLog::debug("飞行记录 debug {}", 7);
+  HERT_LOG_DEBUG("飞行记录超长参数 {}", std::string(200, 'x'));
+  std::thread([]() { HERT_LOG_TRACE("飞行记录 线程{}", 1); }).join();
+  {
+    // 运行时格式串在调用返回后销毁，记录中保存的是格式化后的文本
+    auto format = std::make_unique<std::string>("飞行记录 运行时格式 {} {}");
+    HertLog::trace(fmt::runtime(*format), 1, "a");
+    format->assign(format->size(), '#');
+  }
+  {
+    // 转储时分类对象已销毁，记录中的名称仍然有效
+    auto category = std::make_unique<LogCategory>(
+        std::string("flight.") + std::string(40, 'c'));
+    HERT_CLOG_TRACE(*category, "飞行记录 临时分类");
+  }
+
+  const int fd = ::open(dump_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(fd >= 0);
+  const std::size_t dumped = HertLog::dumpFlightRecorder(fd);
+  ::close(fd);
+  HertLog::disableFlightRecorder();
+  HertLog::shutdown();
+
+  std::vector<BinaryLogEntry> entries;
+  {
+    HertLogBinaryReader reader(dump_path);
+    BinaryLogEntry entry;
+    while (reader.next(entry)) {
+      entries.push_back(entry);
+    }
+  }
+  REQUIRE(entries.size() == dumped);
+  const auto find = [&](std::string_view message) -> const BinaryLogEntry*
+  {
+    const auto found =
+        std::find_if(entries.begin(),
+                     entries.end(),
+                     [&](const BinaryLogEntry& entry)
+                     { return entry.message == message; });
+    return found == entries.end() ? nullptr : &*found;
+  };
+
+  const BinaryLogEntry* trace = find("飞行记录 42 trace");
+  REQUIRE(trace != nullptr);
+  REQUIRE(trace->level == LogLevel::TRACE);
+  REQUIRE(trace->file.ends_with("HertLog_test.cpp"));
+  REQUIRE(trace->line > 0);
+  REQUIRE(find("飞行记录 3.5") != nullptr);
+  REQUIRE(find("飞行记录 debug 7") != nullptr);
+  REQUIRE(find("飞行记录超长参数 {}") != nullptr);
+  REQUIRE(find("飞行记录 线程1") != nullptr);
+  REQUIRE(find("飞行记录 运行时格式 1 a") != nullptr);
+  const BinaryLogEntry* temporary = find("飞行记录 临时分类");
+  REQUIRE(temporary != nullptr);
+  REQUIRE(temporary->category == "flight." + std::string(40, 'c'));
+  REQUIRE(find("飞行记录循环 99") != nullptr);
+  REQUIRE(find("飞行记录循环 0") == nullptr);
+
+  // 停止记录后被过滤的宏恢复为不求值参数
+  int evaluated = 0;
+  const auto count = [&evaluated]()
+  {
+    ++evaluated;
+    return evaluated;
+  };
+  HERT_LOG_TRACE("不求值 {}", count());
+  REQUIRE(evaluated == 0);
+
+  std::filesystem::remove_all(dump_dir);
+}
+#endif
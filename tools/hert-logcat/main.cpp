@@ -0,0 +1,191 @@
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/pattern_formatter.h>
+
+#include "Hert/HertLogBinary.hpp"
+
+namespace
+{
+using Clock = std::chrono::system_clock;
+
+// 与HertLog文件sink的默认格式一致
+constexpr const char* kDefaultPattern = "[%Y-%m-%d %H:%M:%S.%e] [%l] %v";
+
+void print_usage()
+{
+  fmt::print(
+      "用法: hert-logcat [选项] <文件>...\n"
+      "将HertLog二进制日志解码为文本输出到标准输出\n"
+      "\n"
+      "选项:\n"
+      "  -l, --level <级别>    最低级别: trace/debug/info/warn/error/critical\n"
+      "  -s, --since <时间>    只输出不早于该时间的记录\n"
+      "  -u, --until <时间>    只输出不晚于该时间的记录\n"
+      "  -p, --pattern <格式>  spdlog格式模式，默认 \"{}\"\n"
+      "  -h, --help            显示帮助\n"
+      "\n"
+      "时间为本地时间 \"YYYY-MM-DD HH:MM:SS\" 或Unix时间戳(秒)\n",
+      kDefaultPattern);
+}
+
+std::optional<Hert::LogLevel> parse_level(std::string_view name)
+{
+  const auto level = spdlog::level::from_str(std::string(name));
+  if (level == spdlog::level::off && name != "off") {
+    return std::nullopt;
+  }
+  // LogLevel与spdlog::level::level_enum的取值一一对应
+  return static_cast<Hert::LogLevel>(level);
+}
+
+std::optional<Clock::time_point> parse_time(const std::string& text)
+{
+  if (!text.empty()
+      && text.find_first_not_of("0123456789") == std::string::npos)
+  {
+    return Clock::from_time_t(static_cast<std::time_t>(std::stoll(text)));
+  }
+
+  std::tm tm {};
+  std::istringstream input(text);
+  input >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+  if (input.fail()) {
+    return std::nullopt;
+  }
+  tm.tm_isdst = -1;
+  return Clock::from_time_t(std::mktime(&tm));
+}
+
+struct Options
+{
+  Hert::LogLevel level = Hert::LogLevel::TRACE;
+  std::optional<Clock::time_point> since;
+  std::optional<Clock::time_point> until;
+  std::string pattern = kDefaultPattern;
+  std::vector<std::string> files;
+};
+
+// 解析失败时返回空，由调用者打印帮助
+std::optional<Options> parse_options(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    if (arg == "-h" || arg == "--help") {
+      return std::nullopt;
+    }
+    if (!arg.starts_with("-")) {
+      options.files.emplace_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fmt::print(stderr, "选项 {} 缺少参数\n", arg);
+      return std::nullopt;
+    }
+    const std::string value(argv[++i]);
+    if (arg == "-l" || arg == "--level") {
+      const auto level = parse_level(value);
+      if (!level) {
+        fmt::print(stderr, "无效的日志级别: {}\n", value);
+        return std::nullopt;
+      }
+      options.level = *level;
+    } else if (arg == "-s" || arg == "--since" || arg == "-u"
+               || arg == "--until")
+    {
+      const auto time = parse_time(value);
+      if (!time) {
+        fmt::print(stderr, "无效的时间: {}\n", value);
+        return std::nullopt;
+      }
+      (arg == "-s" || arg == "--since" ? options.since : options.until) = time;
+    } else if (arg == "-p" || arg == "--pattern") {
+      options.pattern = value;
+    } else {
+      fmt::print(stderr, "未知选项: {}\n", arg);
+      return std::nullopt;
+    }
+  }
+  if (options.files.empty()) {
+    return std::nullopt;
+  }
+  return options;
+}
+
+bool accepted(const Options& options, const Hert::BinaryLogEntry& entry)
+{
+  return entry.level >= options.level
+      && (!options.since || entry.time >= *options.since)
+      && (!options.until || entry.time <= *options.until);
+}
+
+// 按HertLog写文本日志时相同的方式拼出消息并套用格式模式
+void print_entry(spdlog::pattern_formatter& formatter,
+                 const Hert::BinaryLogEntry& entry)
+{
+  std::string text;
+  if (entry.line > 0 && !entry.function.empty()) {
+    const auto slash = entry.file.find_last_of("/\\");
+    text = fmt::format("[{}:{}] [{}] {}",
+                       slash == std::string::npos
+                           ? entry.file
+                           : entry.file.substr(slash + 1),
+                       entry.line,
+                       entry.function,
+                       entry.message);
+  } else {
+    text = entry.message;
+  }
+
+  spdlog::details::log_msg msg(
+      spdlog::source_loc {
+          entry.file.c_str(), entry.line, entry.function.c_str()},
+      entry.category.empty() ? "hert_logger" : entry.category,
+      static_cast<spdlog::level::level_enum>(entry.level),
+      text);
+  msg.time = entry.time;
+  msg.thread_id = entry.thread_id;
+
+  spdlog::memory_buf_t line;
+  formatter.format(msg, line);
+  std::fwrite(line.data(), 1, line.size(), stdout);
+}
+}  // anonymous namespace
+
+auto main(int argc, char** argv) -> int
+{
+  const auto options = parse_options(argc, argv);
+  if (!options) {
+    print_usage();
+    return 2;
+  }
+
+  spdlog::pattern_formatter formatter(options->pattern);
+  int status = 0;
+  for (const auto& file : options->files) {
+    try {
+      Hert::HertLogBinaryReader reader(file);
+      Hert::BinaryLogEntry entry;
+      while (reader.next(entry)) {
+        if (accepted(*options, entry)) {
+          print_entry(formatter, entry);
+        }
+      }
+    } catch (const std::exception& e) {
+      fmt::print(stderr, "{}: {}\n", file, e.what());
+      status = 1;
+    }
+  }
+  return status;
+}